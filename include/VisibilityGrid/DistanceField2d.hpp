@@ -0,0 +1,32 @@
+#ifndef MOVE4D_DISTANCEFIELD2D_HPP
+#define MOVE4D_DISTANCEFIELD2D_HPP
+
+#include <move4d/API/Grids/NDGrid.hpp>
+
+#include <limits>
+
+namespace move4d {
+
+/// Navigation distance from one cell of a 2D free space grid, 8-connected.
+/// Same queries as API::ndGridAlgo::Dijkstra, computed on flat arrays.
+class DistanceField2d
+{
+public:
+    typedef API::nDimGrid<bool,2> FreeGrid;
+
+    DistanceField2d();
+    /// distances (in the unit of the grid) to the cell from, through the free cells of free.
+    /// Cells farther than cutoff are not explored, their distance is infinite.
+    DistanceField2d(const FreeGrid &free, const FreeGrid::ArrayCoord &from, float cutoff=std::numeric_limits<float>::infinity());
+
+    /// distance at the cell containing pos (throws FreeGrid::out_of_grid)
+    float getCostPos(const FreeGrid::SpaceCoord &pos) const;
+    const API::nDimGrid<float,2> &getGrid() const {return _dist;}
+
+private:
+    API::nDimGrid<float,2> _dist;
+};
+
+} // namespace move4d
+
+#endif // MOVE4D_DISTANCEFIELD2D_HPP
@@ -0,0 +1,37 @@
+#ifndef MOVE4D_DISTANCETRANSFORM_HPP
+#define MOVE4D_DISTANCETRANSFORM_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace move4d {
+
+class WorkerPool;
+
+/// Exact euclidean distance transform of 2D bitmaps (Felzenszwalb and Huttenlocher),
+/// linear in the number of cells. Cells are stored row by row (index x+nx*y).
+class DistanceTransform
+{
+public:
+    /// @param cell_size_x,cell_size_y size of a cell, distances are expressed in the same unit
+    DistanceTransform(size_t nx, size_t ny, float cell_size_x, float cell_size_y);
+
+    /// squared distance from the center of each cell to the center of the closest occupied cell
+    /// (infinity if there is no occupied cell). Runs in parallel over the rows then the columns.
+    void computeSquared(const std::vector<unsigned char> &occupied, std::vector<float> &dist2, WorkerPool &pool) const;
+
+    size_t nx() const {return _nx;}
+    size_t ny() const {return _ny;}
+
+private:
+    /// 1D squared distance transform of the n values f[0], f[stride], ... (positions spaced by step), in place.
+    /// v, z and d are buffers of size n, n+1 and n
+    static void transform1d(float *f, size_t n, size_t stride, float step, std::vector<size_t> &v, std::vector<float> &z, std::vector<float> &d);
+
+    size_t _nx,_ny;
+    float _sx,_sy;
+};
+
+} // namespace move4d
+
+#endif // MOVE4D_DISTANCETRANSFORM_HPP
@@ -7,10 +7,10 @@
 #include <string>
 #include <move4d/Logging/Logger.h>
 #include <move4d/API/moduleBase.hpp>
+#include "VisibilityGrid/RouteTimes.hpp"
 
 
 namespace move4d {
-namespace mho{class SimpleGraph;}
 namespace LocationIndicator{
 
 struct TargetInformation
@@ -43,10 +43,19 @@ public:
     void runCompare(TargetInformation &target);
     void run();
 
+    /// read the graph in the parameter LocationIndicator/routes (nodes, with an optional name, and edges {from,to,cost})
+    /// and compute the route times between its nodes. Done again only when the nodes or the edges changed.
     void loadRouteGraph();
+    /// index of the route node with that name, -1 if none
+    int routeNode(const std::string &name) const;
+    /// route time between the nodes named from and to, negative if one is unknown
+    float routeTime(const std::string &from, const std::string &to) const;
 
 private:
-    mho::SimpleGraph *mRouteGraph=nullptr;
+    bool mRoutesLoaded=false;
+    std::vector<std::string> mRouteNodeNames; ///< empty for the unnamed nodes
+    std::vector<RouteTimes::Edge> mRouteEdges; ///< as read, mRouteTimes is computed from them
+    RouteTimes mRouteTimes;
 };
 
 }
@@ -9,9 +9,19 @@
 #include <move4d/API/Graphic/DrawablePool.hpp>
 
 #include "VisibilityGrid/VisibilityGrid.hpp"
+#include "VisibilityGrid/DistanceField2d.hpp"
+#include "VisibilityGrid/RegionMap.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <mutex>
 
 
 namespace move4d {
+namespace API{class CylinderCollision;}
+class WorkerPool;
 
 template<typename C>
 struct MyCell;
@@ -105,39 +115,427 @@ public:
     using Cost = MyCost<5,3,MyConstraints,MyCosts>;
     using Cell = MyCell<Cost>;
     using Grid = typename API::nDimGrid<Cell*,4>;
+    using Positions2d = std::vector<Eigen::Vector2d,Eigen::aligned_allocator<Eigen::Vector2d> >;
+
+    /// details of the evaluation of a cell, only produced for the cells being inspected
+    struct CostTrace
+    {
+        struct Target
+        {
+            float angle_h,angle_r,angle_persp; ///< degrees
+            float visib;
+            float cost;
+        };
+        std::vector<Target> targets; ///< same order as PlanningData::targets
+        float dist_r,dist_h;
+        float time_h,time_r,time_dir;
+        float proxemics;
+        float target_cost;
+
+        /// named values, as expected by global_costSpace->setCostDetails()
+        std::map<std::string,double> toMap(const std::vector<Robot*> &target_robots) const;
+    };
+
+    /// state needed to evaluate costs, one per thread so that cells can be evaluated concurrently
+    struct EvalContext
+    {
+        EvalContext();
+        std::shared_ptr<API::CylinderCollision> collision;
+        std::vector<float> visib,visib_rob; ///< scratch buffers
+        std::vector<Cost> target_costs; ///< scratch buffer of combineCost()
+        CostTrace *trace=nullptr; ///< if set, receives the details of the cells evaluated with this context
+        bool interpolate=false; ///< computeCost() interpolates the visibilities and distances between the cell centers
+    };
+
+    /// terms of the cost depending only on the position of one agent
+    struct AgentTerms
+    {
+        bool free; ///< not in collision with the environment
+        float dist; ///< navigation distance from the start position
+        float dist_target; ///< navigation distance to the physical target (human only)
+    };
+    /// terms of the cost depending on the positions of both agents but not on their start positions:
+    /// the aggregated costs of the targets
+    struct PairTerms
+    {
+        bool ready=false;
+        uint best_target,worst_target,worst_optional;
+        Cost best_target_cost,worst_target_cost,worst_optional_cost;
+        std::vector<Cost> mandatory_costs; ///< cost of each mandatory target (any target mode only)
+    };
+    /// what the grids computed by resetFromCurrentInitPos() depend on
+    struct PrecomputationKey
+    {
+        unsigned long sceneRevision=0;
+        unsigned long gridRevision=0; ///< VisibilityGridLoader::revision()
+        uint64_t staticObstacles=0; ///< staticObstaclesHash()
+        uint64_t movableObstacles=0; ///< movableObstaclesHash()
+        Robot *r=nullptr,*h=nullptr;
+        Eigen::Vector2d start_r,start_h;
+        bool usePhysicalTarget=false;
+        Eigen::Vector2d physicalTarget;
+        std::vector<double> bounds;
+        VisibilityGrid3d *visibilityGrid=nullptr;
+        VisibilityGrid3d::SpaceCoord cellSize;
+        float footprintRadius_r,footprintRadius_h;
+        bool operator==(const PrecomputationKey &other) const;
+        /// same except for the start and target positions (the collision grids and the visibilities are the same)
+        bool sameScene(const PrecomputationKey &other) const;
+    };
+
+    /// data computed from the scene and the initial positions of the agents,
+    /// shared by all the PlanningData having the same PrecomputationKey (see borrowPrecomputation())
+    struct Precomputation
+    {
+        PrecomputationKey key;
+        API::nDimGrid<bool,2> freespace_h,freespace_r;///< cell is true if in free space
+        /// navigation distances from the start positions and to the physical target
+        DistanceField2d distGrid_h,distGrid_r,distGrid_physicalTarget;
+        size_t nx=0,ny=0; ///< shape of the freespace grids
+        Eigen::Vector3d perspectiveOffset_r,perspectiveOffset_h;///< perspective position in the agent base frame
+        /// minimal distance between the robot and the human bases for their cylinders not to collide
+        /// (negative if it could not be measured, then the collision checker is used for each cell)
+        float agentsClearance=-1.f;
+
+        /// visibility costs of target from the perspective of agent (0: robot, 1: human),
+        /// at the center of each cell of the freespace grids (index x+nx*y), computed on first request (thread safe)
+        const std::vector<float> &visibilitySlice(uint agent, Robot *target);
+
+        struct VisibilitySlices
+        {
+            std::mutex mutex;
+            std::map<std::pair<uint,Robot*>,std::vector<float> > slices;
+        };
+        /// shared by the precomputations of the same scene
+        std::shared_ptr<VisibilitySlices> slices;
+
+        /// decomposition of freespace_h for that doorway width, computed on first request (thread safe)
+        std::shared_ptr<const RegionMap> regionMap(float doorway_width, unsigned int threads);
+        struct RegionMaps
+        {
+            std::mutex mutex;
+            std::map<float,std::shared_ptr<const RegionMap> > maps;
+        };
+        /// shared by the precomputations of the same scene
+        std::shared_ptr<RegionMaps> regions;
+    };
+
+    /// AgentTerms (and visibility costs of the targets) of each 2D cell of the planning lattice, filled on demand
+    struct AgentTermsTable
+    {
+        void reset(size_t nx, size_t ny, size_t ntargets);
+        size_t index(const Cell *c, uint agent) const {return c->coord[agent*2] + nx*c->coord[agent*2+1];}
+        size_t nx=0,ntargets=0;
+        std::vector<AgentTerms> terms;
+        std::vector<float> visib;
+        std::vector<char> ready;
+        std::vector<unsigned long> distVersion; ///< precomputationVersion used for the distance terms
+    };
+    /// what the memoized terms of the lattice depend on, apart from the start positions
+    struct LatticeTermsKey
+    {
+        PrecomputationKey scene; ///< compared with PrecomputationKey::sameScene()
+        Grid::ArrayCoord shape;
+        Grid::ArrayCoord offset; ///< latticeOffset
+        std::vector<Robot*> targets;
+        uint indexFirstOptionalTarget;
+        std::vector<Eigen::Vector3d> targetPos;
+        std::vector<float> routeDirTimes;
+        std::vector<float> params; ///< the ones used by targetCost()
+        bool operator==(const LatticeTermsKey &other) const;
+    };
 
     Cell run(bool read_parameters=true);
+    /// the lattice engine of run(), on the regions kept by restrictToRegions() if prune_regions
+    /// (then on the whole scene if no valid solution is found in them)
+    Cell runLattice(std::chrono::steady_clock::time_point run_start, bool prune_regions);
+
+    /// how run() searches
+    enum class Engine{
+        LATTICE, ///< the lattice of all the placements of the two agents
+        SAMPLING ///< random placements, then local refinement (see runSampling())
+    };
+    static Engine engineFromName(const std::string &name);
+    /// the sampling engine of run(): samplingSamples placements are drawn, the human around the start in reach,
+    /// preferably where the targets are visible, the robot around the human at the proxemics distance.
+    /// Then half as many are drawn around the best ones, at decreasing distances.
+    /// The cost of a query depends on the number of samples, not on the size of the map
+    /// (apart from the precomputed grids). No alternatives are kept, status.expansions counts the batches of evaluations.
+    Cell runSampling(std::chrono::steady_clock::time_point run_start);
+    /// the group mode of run(), for h and the humans of group. The search is factorized: each human keeps the
+    /// groupCandidates positions it reaches first among the ones where it sees the mandatory targets (from the grids of
+    /// its groupPlans), then each robot position in reach is evaluated with the best joint assignment of the candidates
+    /// to the humans, at least groupSeparation apart (branch and bound on the costs of each human at each candidate).
+    /// The cost of the group is the worst constraint and the mean cost of the humans.
+    /// The evaluations grow linearly with the size of the group.
+    /// The result is the cell of h (with the cost of the group), the ones of the others are in groupResult
+    Cell runGroup(std::chrono::steady_clock::time_point run_start);
+    /// move c to a local minimum of the cost in the continuous space of the placements (compass search on the four
+    /// coordinates with the interpolated terms, from half a cell down to a sixteenth). c then has the interpolated cost
+    void refineCell(Cell &c, Cell &start);
+    struct CachedResult;
+    /// move the agents to best and write it, the alternatives and the status in the parameters (not on a snapshot).
+    /// The cost details are taken from cached if set, otherwise they are computed and the result is stored in the result cache
+    void publishResult(Cell &best, const CachedResult *cached=nullptr);
+
+    /// the part of the scene read by run(), copied so that runs can execute on other threads
+    struct SceneSnapshot
+    {
+        RobotState start_r,start_h; ///< initial positions of the agents (the start of the search)
+        RobotState current_r,current_h; ///< current positions of the agents, where their perspectives are
+        Eigen::Vector3d perspective_r,perspective_h;
+        std::vector<Eigen::Vector3d> targetPos; ///< same order as targets
+        Positions2d targetPos2d;
+        uint64_t staticObstacles; ///< staticObstaclesHash()
+        uint64_t movableObstacles; ///< movableObstaclesHash()
+    };
+    /// copy the state of the agents and of the targets read by run()
+    SceneSnapshot takeSnapshot() const;
+    /// if set, run() reads the agents and the targets from it and leaves the robots, global_costSpace,
+    /// the drawings and the parameters untouched: the result is only returned
+    std::shared_ptr<const SceneSnapshot> snapshot;
+    /// run each of plans on its own thread and return their results in the same order, once all ended.
+    /// The plans without snapshot get one of the current scene (set back to null at the end).
+    /// The first exception thrown by a run is rethrown after all of them ended.
+    static std::vector<Cell> runConcurrently(const std::vector<PlanningData*> &plans, bool read_parameters=true);
+
+    /// state of the lattice search of run(), shared by its passes
+    struct LatticeSearch
+    {
+        Grid *grid;
+        Cell *start;
+        Cell *best;
+        std::vector<Cell*> created; ///< all the cells allocated in grid
+        uint count=0; ///< expansions
+        uint iter_of_best=0;
+        uint passes=0;
+        bool stopped=false; ///< by the deadline or a cancellation
+        bool exhaustive=true; ///< no pass stopped before visiting all the cells it could reach
+        std::chrono::steady_clock::time_point deadline_time;
+        /// if set, cells where the human is at an index where this is 0 are only traversed (see transitCost())
+        const std::vector<char> *humanVisible=nullptr;
+        std::vector<Cell*> transit; ///< cells that got a transitCost()
+        std::vector<Cell*> alternatives; ///< best cells far enough from each other, sorted (see addAlternative())
+        WorkerPool *pool;
+        std::vector<EvalContext> *contexts;
+        //buffers
+        std::vector<std::pair<Cell*,int> > expansion; ///< neighbours to process, and their index in to_evaluate (-1 if already evaluated)
+        std::vector<Cell*> to_evaluate;
+        std::vector<PairTerms*> to_evaluate_pairs; ///< memoized pair terms of to_evaluate (incremental mode only)
+        std::vector<char> evaluated;
+    };
+    /// what one pass of the search visits
+    struct SearchPass
+    {
+        uint stride=1; ///< the neighbours of a cell are stride cells away on each axis
+        std::vector<Grid::ArrayCoord> windows; ///< if not empty, only the cells at most radius cells away from one of these are visited
+        uint radius=0;
+        std::vector<Cell*> seeds; ///< cells the search starts from, the last one first
+        uint candidates=1; ///< number of best cells returned
+    };
+    /// neighbours of a cell followed by the search
+    enum class MoveSet{
+        FULL, ///< all the 80 neighbours
+        PRUNED, ///< the ones differing on at most 2 axes
+        SINGLE_AGENT, ///< one agent moves at a time
+        AXIS ///< one axis at a time
+    };
+    typedef std::array<long,4> Move;
+    /// offsets of the neighbours of the current moveSet, in the order of Grid::getNeighbour() (coord is any cell)
+    const std::vector<Move> &moveOffsets(const Grid &grid, const Grid::ArrayCoord &coord);
+    static MoveSet moveSetFromName(const std::string &name);
+    static std::string moveSetName(MoveSet set);
+    /// run with each move set from the same initial positions and write the cost, expansions, evaluations and duration
+    /// of each in the parameter PointingPlanner/benchmark/move_sets (the agents are left at the solution of the full move set)
+    void benchmarkMoveSets();
+    /// search from the seeds of pass, updating search.best.
+    /// @return the pass.candidates best cells visited by the pass (best first)
+    std::vector<Cell*> searchPass(LatticeSearch &search, const SearchPass &pass);
+    /// keep c (if valid) among the alternativesCount best visited cells if none of the better ones is close to it, i.e. has the
+    /// same target and both agents less than alternativesSeparation away. The worse ones close to c are dropped.
+    void addAlternative(LatticeSearch &search, Cell *c);
     Cell *createCell(Grid::ArrayCoord coord,Grid::SpaceCoord pos);
     void setRobots(Robot *a,Robot *b, Cell *cell);
+    /// compute the cost of c and publish the details to global_costSpace
     Cost computeCost(Cell *c);
+    /// evaluate c again (without modifying it) and return the details of its cost.
+    /// interpolate: evaluated as refineCell() does, for the cells it moved
+    CostTrace traceCost(const Cell &c, bool interpolate=false);
+    /// compute the cost of c without moving the agents nor touching global_costSpace (thread safe)
+    Cost computeCost(Cell *c, EvalContext &ctx);
+    /// same as computeCost(c,ctx) for a cell of the planning lattice, using the memoized single agent terms.
+    /// prepareLatticeTerms(c) must have been called before (it is not thread safe, this is)
+    /// @param pair if set, the pair terms of c, used if ready, computed otherwise
+    Cost computeCostFactorized(Cell *c, EvalContext &ctx, PairTerms *pair=nullptr);
+    /// combine the single agent terms with the ones depending on both agents
+    Cost combineCost(Cell *c, const AgentTerms &terms_r, const float *visib_r, const AgentTerms &terms_h, const float *visib_h, EvalContext &ctx, PairTerms *pair=nullptr);
+    /// single agent terms for agent (0: robot, 1: human) at pos2d
+    /// @param interpolate bilinear interpolation of the visibilities (from the precomputed slices) and of the distances
+    void computeAgentTerms(uint agent, const Eigen::Vector2d &pos2d, AgentTerms &terms, std::vector<float> &visib, bool interpolate=false);
+    /// the terms of computeAgentTerms() depending on the start positions
+    void computeDistTerms(uint agent, const Eigen::Vector2d &pos2d, AgentTerms &terms);
+    LatticeTermsKey latticeTermsKey(const Grid &grid) const;
+    /// cost of a cell the search goes through but never selects (infinite visibility constraint and cost),
+    /// only the collisions are checked (thread safe, the lattice terms of c must be prepared)
+    Cost transitCost(Cell *c, EvalContext &ctx);
+    /// keep the regions of pre->regionMap() where the agents can go (see isTooFar()) and either containing a start,
+    /// or where the human sees the mandatory targets, or on the path of fewest regions from a start to them,
+    /// or next to such a region. Fills regionCells_r/h and reduces
+    /// envSize (the bounds of the lattice as built by run()) to the cells kept for each agent.
+    /// @return false if nothing is kept (then nothing is changed)
+    bool restrictToRegions(std::vector<double> &envSize);
+    /// set latticeOffset for the lattice grid
+    /// @return false if the cells of grid are not cells of the freespace grids (latticeOffset is then 0)
+    bool computeLatticeOffset(const Grid &grid);
+    /// the agents of c are in the regions kept by restrictToRegions() (true if no restriction)
+    bool inRegions(const Cell *c) const;
+    /// visible[x+nx*y] is 1 if the human in the cell (x,y) of the lattice sees all the mandatory targets
+    /// @return false if none of the cells in reach of the start does
+    bool computeHumanVisibleCells(const Grid &grid, const Cell *start, std::vector<char> &visible);
+    /// pair terms memoized for the lattice cell c (not thread safe, the reference stays valid until the next reset)
+    PairTerms &latticePairTerms(const Cell *c);
+    /// clear the memoized single agent terms, sized for the lattice grid
+    void resetLatticeTerms(const Grid &grid);
+    /// compute the single agent terms of the lattice cell c if not done yet
+    void prepareLatticeTerms(const Cell *c);
+    /// true if the two agents of c are not in collision with each other. Thread safe, but while pre->agentsClearance
+    /// is not calibrated the collision checker is used, one check at a time (under collisionMutex): the evaluations
+    /// in parallel then wait for each other on it
+    bool agentsApart(const Cell *c, EvalContext &ctx);
+    /// measure pre.agentsClearance with the collision checker, from the robot start position
+    void calibrateAgentsClearance(Precomputation &pre);
     std::vector<float> getVisibilites(Robot *r, const Eigen::Vector2d &pos2d);
+    /// visibility costs of the targets from the perspective position persp
+    void getVisibilites(const Eigen::Vector3d &persp, std::vector<float> &visib);
+
+    /// store the position of the targets used when evaluating costs (the agent perspectives are in the precomputation)
+    void updateAgentFrames();
+    /// position of an agent perspective when its base is at pos2d with orientation yaw
+    Eigen::Vector3d perspectivePos(const Eigen::Vector3d &offset, const Eigen::Vector2d &pos2d, double yaw) const;
 
     float computeStateCost(RobotState &q);
 
+    /// how the last run() ended
+    struct RunStatus
+    {
+        bool completed=false; ///< the search ended by itself (not stopped by the deadline nor cancelled)
+        bool deadline_reached=false;
+        bool cancelled=false;
+        uint expansions=0;
+        uint evaluations=0; ///< number of cells whose cost was computed
+        double elapsed=0.; ///< in seconds, including the preparation of the grids
+        /// relative difference between the cost of the result and a lower bound of the optimum, negative if no bound is known.
+        /// The search being greedy, the only bound is from an exhaustive search (then it is 0)
+        float gap=-1.f;
+        bool cached=false; ///< the result comes from the result cache, no search was done
+        bool refined=false; ///< the result and the alternatives were moved by refineCell(), their costs are interpolated
+    };
+    RunStatus status;
+
+    /// a result of run() with what publishResult() writes, kept by the result cache
+    struct CachedResult
+    {
+        Cell best;
+        std::vector<Cell> alternatives;
+        RunStatus status;
+        std::map<std::string,double> details;
+        std::vector<std::map<std::string,double> > alternatives_details;
+    };
+    /// key of the current query in the result cache: hash of the start cells (positions quantized by resultCacheResolution),
+    /// the targets, the parameters of the cost and of the search, and the scene and visibility grid revisions
+    uint64_t resultCacheKey() const;
+    /// the result cached for key (nullptr if none), counted as a hit or a miss
+    static std::shared_ptr<const CachedResult> findCachedResult(uint64_t key);
+    /// store result for key, the least recently used results are dropped beyond capacity.
+    /// The results of other scene or grid revisions are dropped
+    static void storeCachedResult(uint64_t key, const CachedResult &result, size_t capacity,
+                                  unsigned long scene_revision, unsigned long grid_revision);
+    /// forget all the cached results and reset the statistics
+    static void clearResultCache();
+    struct ResultCacheStats
+    {
+        unsigned long hits=0,misses=0;
+        size_t size=0; ///< number of results stored
+    };
+    static ResultCacheStats resultCacheStats();
+
+    /// state of a running search, see progress
+    struct Progress
+    {
+        uint expansions;
+        float best_cost; ///< Cell::CostType::toDouble() of the best cell so far
+    };
+    /// checked after each expansion of run(), that stops and returns the best so far when it returns true
+    std::function<bool()> cancelled;
+    /// called by run() every progressPeriod expansions
+    std::function<void(const Progress&)> progress;
+    uint progressPeriod=100;
+
+    /// result of the evaluation of one placement of the agents by computeStatesCost()
+    struct StateEvaluation
+    {
+        float cost; ///< as computeStateCost() (0 if out of the grids)
+        float visib_h,visib_r; ///< visibility cost of the first target for each agent, as computeStateVisiblity()
+    };
+    /// evaluate the placements (robot_pos[i],human_pos[i]) concurrently, without moving the agents
+    std::vector<StateEvaluation> computeStatesCost(const Positions2d &robot_pos, const Positions2d &human_pos);
+    /// same as above, from the base positions of the robot and human states
+    std::vector<StateEvaluation> computeStatesCost(const std::vector<RobotState> &robot_states, const std::vector<RobotState> &human_states);
+
     void moveHumanToFaceTarget(Cell *c, uint target_id=0);
     void moveRobotToHalfAngle(Cell *c, uint target_id=0);
 
     inline float element(const std::vector<float> &values, float factor=1);
 
     Cost targetCost(Cell *c, uint i, float visib, float visib_r);
-    float getRouteDirTime(Cell *c, uint i);
+    Cost targetCost(const Cell *c, uint i, float visib, float visib_r, EvalContext &ctx);
+    float getRouteDirTime(const Cell *c, uint i);
 
     float visibility(uint target_i, const Eigen::Vector3d &pos);
 
     inline bool isTooFar(Cell* c, Cell* from);
     inline bool areAgentTooFarFromEachOther(Cell* c);
 
-    PlanningData(Robot *r, Robot *h);
+    /// @param init reinit() now, otherwise nothing is read nor computed before the first run() or reinit()
+    PlanningData(Robot *r, Robot *h, bool init=true);
     ~PlanningData();
 
     /// reset the configuration of this from move4d::API::Parameter::root["PointingPlanner"]
     void getParameters();
     /// reset the initial positions of the agents from the move4d::Robot::getInitialPosition()
-    /// computes the collision and navigation grids
+    /// get the collision and navigation grids from borrowPrecomputation()
     void resetFromCurrentInitPos();
     /// perform getParameters and resetFromCurrentInitPos
     void reinit();
-    void initCollisionGrids();
+    /// perform getParameters, and resetFromCurrentInitPos only if what it depends on changed since the last time
+    /// @return true if the grids were recomputed
+    bool refresh();
+    PrecomputationKey precomputationKey() const;
+    /// the precomputation matching key: an existing one if another PlanningData still holds it
+    /// (or it is the last one built), otherwise built by this
+    std::shared_ptr<Precomputation> borrowPrecomputation(const PrecomputationKey &key);
+    /// compute all the data of pre (pre.key must be set).
+    /// The data independent of the start positions is taken from same_scene if set
+    void buildPrecomputation(Precomputation &pre, const std::shared_ptr<Precomputation> &same_scene);
+    /// forget all the shared precomputations (their owners keep them)
+    static void clearSharedPrecomputations();
+    void initCollisionGrids(Precomputation &pre);
+    /// fill the collision grids from a single collision grid (the agent with the smallest footprint)
+    /// and its distance transform, used when footprintRadius_r and footprintRadius_h are set
+    void initCollisionGridsFromFootprint(Precomputation &pre);
+    /// file where the collision grids of the robot and the human are cached, next to the visibility grid
+    /// (empty if the visibility grid file is not found). There is one file per pair of agents
+    std::string gridsCachePath() const;
+    /// hash of what the collision grids depend on (obstacles, agent radii, bounds, cell size, sceneRevision),
+    /// stored in the cache file: a file with another key is not loaded, and is overwritten
+    uint64_t gridsCacheKey() const;
+    /// hash of the names and bounding boxes of the static obstacles (the environment)
+    static uint64_t staticObstaclesHash();
+    /// hash of the names and base poses of the robots other than r and h (the objects checked by initCollisionGrid())
+    uint64_t movableObstaclesHash() const;
+    /// @return false if there is no valid cache at path
+    bool loadGridsCache(Precomputation &pre, const std::string &path);
+    void saveGridsCache(Precomputation &pre, const std::string &path);
     void initCollisionGrid(API::nDimGrid<bool,2> &grid,Robot *a);
 
     Robot *r;
@@ -156,6 +554,8 @@ public:
     float vis_threshold; //maximal visibility cost to consider a object is visible
     float max_dist;//maximal distance run by either agent
     float max_time_r;//maximal time for the robot
+    float deadline; ///< maximal duration of run() in seconds, 0 for none
+    uint threads=0; //number of threads evaluating the costs during the search (0 for hardware concurrency)
     Robot *cyl_r;
     Robot *cyl_h;
     RobotState start_r;
@@ -166,10 +566,57 @@ public:
 
     float ask_to_move_duration, ask_to_move_dist_trigger;
 
+    std::vector<Eigen::Vector3d> targetPos;///< position of the targets (joint 0)
+    Positions2d targetPos2d;///< base position of the targets
+    EvalContext mainContext;
+    AgentTermsTable terms_r,terms_h;
+    bool visibilityPruning=false; ///< only cells where the human sees the mandatory targets are evaluated
+    Engine engine=Engine::LATTICE;
+    bool regionPruning=false; ///< the lattice only spans the regions the search can lead to, see restrictToRegions()
+    float doorwayWidth=1.2f; ///< the passages narrower than this separate the regions
+    std::vector<char> regionCells_r,regionCells_h; ///< cells of the freespace grids kept by restrictToRegions() (empty: all)
+    Grid::ArrayCoord latticeOffset{{0,0,0,0}}; ///< coordinates in the freespace grids of the lattice cell 0, for each agent
+    bool refine=false; ///< the result of the search is refined by refineCell()
+    std::vector<Robot*> group; ///< the other humans guided with h (not empty: group mode, see runGroup())
+    uint groupCandidates=20; ///< positions of each human evaluated with each robot position by runGroup()
+    float groupSeparation=0.6f; ///< minimal distance between two humans of the group
+    /// one for each human of group, with its own grids (the robot and h of this, that human as its h)
+    std::vector<std::unique_ptr<PlanningData> > groupPlans;
+    std::vector<Cell> groupResult; ///< placement of the robot and each human of group found by the last runGroup()
+    uint samplingSamples=2000; ///< number of placements drawn by the global phase of runSampling()
+    unsigned int samplingSeed=0; ///< the sampling is deterministic for a given seed
+    MoveSet moveSet=MoveSet::FULL;
+    MoveSet movesBuiltFor=MoveSet::FULL; ///< the move set moves was built for (see moveOffsets())
+    std::vector<Move> moves;
+    uint multiresLevels=0; ///< number of coarser levels searched before the lattice, each with twice larger cells (all the cells are searched when they find no valid solution)
+    uint multiresCandidates=3; ///< number of cells of a level refined at the next one
+    uint alternativesCount=0; ///< number of ranked solutions kept by run() (0: only the best one)
+    float alternativesSeparation=1.f; ///< minimal distance of an agent between two alternatives with the same target
+    std::vector<Cell> alternatives; ///< valid solutions of the last run(), best first (the first is the result, if valid)
+    /// the mandatory targets are alternatives (e.g. references to a location): each cell is evaluated for each of them,
+    /// with its route time, and keeps the best one, instead of having to show all of them
+    bool anyTarget=false;
+    bool incremental=false; ///< keep the memoized terms and the best solution from one run to the next
+    LatticeTermsKey latticeTerms; ///< key of terms_r, terms_h and pairTerms
+    std::unordered_map<size_t,PairTerms> pairTerms; ///< by lattice cell, index terms_r.index(c,0)+nxy_r*terms_h.index(c,1)
+    bool hasLastBest=false;
+    Grid::ArrayCoord lastBest; ///< coordinates of the result of the previous run
+    float footprintRadius_r=-1.f,footprintRadius_h=-1.f; ///< radius of the agent cylinders (negative if unknown)
+    bool useGridsCache=true; ///< load/save the collision grids from/to disk
+    /// the precomputed grids (in memory and in the grids cache) are rebuilt when the environment or the base of another
+    /// robot moved (staticObstaclesHash(), movableObstaclesHash()). Anything else changing the collisions, such as a
+    /// joint of an object or a geometry edited in place, is not detected: then increment this
+    /// (parameter PointingPlanner/scene_revision) for the grids to be recomputed
+    unsigned long sceneRevision=0;
+    uint resultCacheSize=0; ///< number of results of run() kept in the result cache shared by all PlanningData (0: no cache)
+    float resultCacheResolution=0.1f; ///< the start positions closer than this share their cached results
+    uint64_t resultKey=0; ///< resultCacheKey() of the current run, if the cache is used
+    std::shared_ptr<Precomputation> pre; ///< collision and navigation grids
+    PrecomputationKey precomputed; ///< key of the current collision and distance grids
+    unsigned long precomputationVersion=0; ///< incremented each time the grids are changed (0: never computed)
+
     std::shared_ptr<move4d::Graphic::LinkedBalls2d> balls;
 
-    API::nDimGrid<bool,2> freespace_h,freespace_r;///< cell is true if in free space
-    API::ndGridAlgo::Dijkstra<API::nDimGrid<bool,2>,float> distGrid_h,distGrid_r,distGrid_physicalTarget;
     float computeStateVisiblity(RobotState &state);
 };
 
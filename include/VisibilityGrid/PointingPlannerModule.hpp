@@ -4,8 +4,14 @@
 #include <move4d/Logging/Logger.h>
 #include <move4d/API/moduleBase.hpp>
 
+#include "VisibilityGrid/PointingPlanner.hpp"
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+
 namespace move4d {
-struct PlanningData;
 
 class PointingPlanner : public ModuleBase
 {
@@ -15,10 +21,40 @@ class PointingPlanner : public ModuleBase
 public:
     static std::string name(){return "PointingPlanner";}
 
+    /// handle on a run started by runAsync()
+    class RunHandle
+    {
+    public:
+        /// ask the run to stop, it then returns the best solution found so far
+        void cancel();
+        /// wait for the result, then move the agents to it and write it in the parameters, from the calling thread
+        /// (the planning thread leaves the scene untouched). Rethrows the exceptions of the run
+        PlanningData::Cell publish();
+        /// the result of PlanningData::run(), get() rethrows its exceptions
+        std::shared_future<PlanningData::Cell> result;
+    private:
+        friend class PointingPlanner;
+        std::shared_ptr<std::atomic<bool> > _cancel;
+        std::shared_ptr<PlanningData> _data; ///< planning on a snapshot of the scene taken by runAsync()
+    };
+
     virtual void initialize() override;
+    /// blocking run, preempts the asynchronous one if any
     virtual void run() override;
+    /// start a run on another thread, on its own PlanningData and a snapshot of the scene taken by the calling thread
+    /// (see RunHandle::publish()). The previous asynchronous run, if not finished, is cancelled
+    /// (and waited for, the search stops at the end of the current expansion).
+    /// @param progress called from the planning thread every PlanningData::progressPeriod expansions
+    RunHandle runAsync(std::function<void(const PlanningData::Progress&)> progress=std::function<void(const PlanningData::Progress&)>());
+    /// blocking, see PlanningData::benchmarkMoveSets()
+    void benchmarkMoveSets();
 private:
+    /// cancel the current asynchronous run and wait for it (_asyncMutex must be locked)
+    void preempt();
+
     struct PlanningData *_data;
+    std::mutex _asyncMutex;
+    RunHandle _current;
 };
 
 } // namespace move4d
@@ -0,0 +1,41 @@
+#ifndef MOVE4D_REGIONMAP_HPP
+#define MOVE4D_REGIONMAP_HPP
+
+#include <move4d/API/Grids/NDGrid.hpp>
+
+#include <vector>
+
+namespace move4d {
+
+class WorkerPool;
+
+/// Decomposition of a 2D free space grid into regions (rooms, corridors) separated by its narrow passages (doorways).
+/// The cores of the regions are the connected parts of the free space farther than half the doorway width from the
+/// obstacles, the other free cells belong to the closest core. Cells are stored row by row (index x+nx*y).
+class RegionMap
+{
+public:
+    typedef API::nDimGrid<bool,2> FreeGrid;
+
+    RegionMap();
+    /// @param doorway_width the passages narrower than this separate two regions
+    RegionMap(const FreeGrid &free, float doorway_width, WorkerPool &pool);
+
+    /// region of the cell x+nx*y, -1 if it is not free
+    int region(size_t i) const {return _labels[i];}
+    size_t nx() const {return _nx;}
+    size_t ny() const {return _ny;}
+    /// number of regions
+    size_t size() const {return _adjacent.size();}
+    /// the regions sharing a border with r
+    const std::vector<int> &adjacent(int r) const {return _adjacent[r];}
+
+private:
+    size_t _nx,_ny;
+    std::vector<int> _labels;
+    std::vector<std::vector<int> > _adjacent;
+};
+
+} // namespace move4d
+
+#endif // MOVE4D_REGIONMAP_HPP
@@ -0,0 +1,35 @@
+#ifndef MOVE4D_ROUTETIMES_HPP
+#define MOVE4D_ROUTETIMES_HPP
+
+#include <limits>
+#include <vector>
+
+namespace move4d {
+
+/// Shortest route times between all the pairs of nodes of a route graph with undirected edges,
+/// stored in one n*n matrix.
+class RouteTimes
+{
+public:
+    struct Edge
+    {
+        unsigned int from,to;
+        float time;
+    };
+
+    RouteTimes();
+    /// edges with an unknown node or a negative time are ignored
+    RouteTimes(unsigned int nodes, const std::vector<Edge> &edges);
+
+    unsigned int size() const {return _n;}
+    /// infinite if to is not reachable from from
+    float time(unsigned int from, unsigned int to) const {return _times[from*_n+to];}
+
+private:
+    unsigned int _n;
+    std::vector<float> _times;
+};
+
+} // namespace move4d
+
+#endif // MOVE4D_ROUTETIMES_HPP
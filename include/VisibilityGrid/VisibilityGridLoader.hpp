@@ -20,11 +20,17 @@ public:
     virtual void initialize() override;
 
     VisibilityGrid3d *grid() const;
+    /// read the file again into grid()
+    /// @return false if no file could be read
+    bool reload();
+    /// incremented each time the grid is read, to invalidate what was computed from it
+    unsigned long revision() const {return _revision;}
 
 private:
     bool loadBinary();
     bool loadText();
     VisibilityGrid3d *_grid=nullptr;
+    unsigned long _revision=0;
     static VisibilityGridLoader *__instance;
 };
 
@@ -0,0 +1,49 @@
+#ifndef MOVE4D_WORKERPOOL_HPP
+#define MOVE4D_WORKERPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace move4d {
+
+/// Fixed size pool of threads running index based jobs.
+/// The calling thread takes part in the work as worker 0, so a pool of size 1 does not spawn any thread.
+class WorkerPool
+{
+public:
+    /// @param threads number of workers (including the calling thread), 0 to use the hardware concurrency
+    explicit WorkerPool(unsigned int threads);
+    ~WorkerPool();
+
+    /// number of workers, ids given to the jobs are in [0,size())
+    unsigned int size() const {return _size;}
+
+    /// calls job(i,worker) for each i in [0,n) and waits for all of them to finish.
+    /// The first exception thrown by a job is rethrown in the calling thread.
+    void parallelFor(size_t n, const std::function<void(size_t,unsigned int)> &job);
+
+private:
+    void work(unsigned int worker);
+    void loop(unsigned int worker);
+
+    unsigned int _size;
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _wake,_done;
+    const std::function<void(size_t,unsigned int)> *_job=nullptr;
+    size_t _n=0;
+    std::atomic<size_t> _next;
+    unsigned int _running=0;
+    unsigned long _generation=0;
+    bool _stop=false;
+    std::exception_ptr _error;
+};
+
+} // namespace move4d
+
+#endif // MOVE4D_WORKERPOOL_HPP
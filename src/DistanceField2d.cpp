@@ -0,0 +1,71 @@
+#include "VisibilityGrid/DistanceField2d.hpp"
+
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace move4d {
+
+DistanceField2d::DistanceField2d()
+{
+}
+
+DistanceField2d::DistanceField2d(const FreeGrid &free, const FreeGrid::ArrayCoord &from, float cutoff):
+    _dist(free)
+{
+    const float inf=std::numeric_limits<float>::infinity();
+    FreeGrid::ArrayCoord last=free.getCellCoord(free.getNumberOfCells()-1);
+    const long nx=last[0]+1, ny=last[1]+1;
+    //flat arrays, index x+nx*y
+    std::vector<unsigned char> passable(nx*ny);
+    for(size_t i=0;i<free.getNumberOfCells();++i){
+        FreeGrid::ArrayCoord c=free.getCellCoord(i);
+        passable[c[0]+nx*c[1]]=free.getCell(i);
+    }
+    std::vector<float> dist(nx*ny,inf);
+
+    const float sx=free.getCellSize()[0], sy=free.getCellSize()[1];
+    const float sxy=std::sqrt(sx*sx+sy*sy);
+    const long dx[8]={1,-1,0,0,1,1,-1,-1};
+    const long dy[8]={0,0,1,-1,1,-1,1,-1};
+    const float step[8]={sx,sx,sy,sy,sxy,sxy,sxy,sxy};
+
+    typedef std::pair<float,long> Entry;
+    std::priority_queue<Entry,std::vector<Entry>,std::greater<Entry> > open;
+    long start=from[0]+nx*from[1];
+    dist[start]=0.f;
+    open.push(Entry(0.f,start));
+    while(!open.empty()){
+        Entry e=open.top();
+        open.pop();
+        if(e.first>dist[e.second]) continue; //outdated entry
+        if(e.first>cutoff) break;
+        long x=e.second%nx, y=e.second/nx;
+        for(unsigned int k=0;k<8;++k){
+            long xn=x+dx[k], yn=y+dy[k];
+            if(xn<0 || yn<0 || xn>=nx || yn>=ny) continue;
+            long n=xn+nx*yn;
+            if(!passable[n]) continue;
+            float d=e.first+step[k];
+            if(d<dist[n]){
+                dist[n]=d;
+                open.push(Entry(d,n));
+            }
+        }
+    }
+
+    for(size_t i=0;i<_dist.getNumberOfCells();++i){
+        FreeGrid::ArrayCoord c=_dist.getCellCoord(i);
+        float d=dist[c[0]+nx*c[1]];
+        _dist[i] = (d>cutoff ? inf : d);
+    }
+}
+
+float DistanceField2d::getCostPos(const FreeGrid::SpaceCoord &pos) const
+{
+    return _dist.getCell(pos);
+}
+
+} // namespace move4d
@@ -0,0 +1,83 @@
+#include "VisibilityGrid/DistanceTransform.hpp"
+#include "VisibilityGrid/WorkerPool.hpp"
+
+#include <limits>
+
+namespace move4d {
+
+DistanceTransform::DistanceTransform(size_t nx, size_t ny, float cell_size_x, float cell_size_y):
+    _nx(nx),_ny(ny),_sx(cell_size_x),_sy(cell_size_y)
+{
+}
+
+void DistanceTransform::computeSquared(const std::vector<unsigned char> &occupied, std::vector<float> &dist2, WorkerPool &pool) const
+{
+    const float inf=std::numeric_limits<float>::infinity();
+    dist2.resize(_nx*_ny);
+    for(size_t i=0;i<dist2.size();++i){
+        dist2[i] = (occupied[i] ? 0.f : inf);
+    }
+    std::vector<std::vector<size_t> > v(pool.size());
+    std::vector<std::vector<float> > z(pool.size()),d(pool.size());
+    //along x, each row is independent
+    pool.parallelFor(_ny,[&](size_t y,unsigned int w){
+        transform1d(dist2.data()+_nx*y,_nx,1,_sx,v[w],z[w],d[w]);
+    });
+    //then along y, each column is independent
+    pool.parallelFor(_nx,[&](size_t x,unsigned int w){
+        transform1d(dist2.data()+x,_ny,_nx,_sy,v[w],z[w],d[w]);
+    });
+}
+
+namespace {
+/// abscissa where the parabolas rooted at p and q>p cross
+inline float parabolasIntersection(const float *f, size_t stride, float step, size_t p, size_t q)
+{
+    float pp=p*step, pq=q*step;
+    return ((f[q*stride]+pq*pq)-(f[p*stride]+pp*pp))/(2*(pq-pp));
+}
+}
+
+void DistanceTransform::transform1d(float *f, size_t n, size_t stride, float step, std::vector<size_t> &v, std::vector<float> &z, std::vector<float> &d)
+{
+    const float inf=std::numeric_limits<float>::infinity();
+    v.resize(n);
+    z.resize(n+1);
+    d.resize(n);
+    //lower envelope of the parabolas rooted at the finite values
+    size_t k=0;
+    bool empty=true;
+    for(size_t q=0;q<n;++q){
+        if(f[q*stride]==inf) continue;
+        if(empty){
+            v[0]=q;
+            z[0]=-inf;
+            z[1]=inf;
+            empty=false;
+            continue;
+        }
+        //z[0] is -infinity, so k does not go below 0
+        float s=parabolasIntersection(f,stride,step,v[k],q);
+        while(s<=z[k]){
+            --k;
+            s=parabolasIntersection(f,stride,step,v[k],q);
+        }
+        ++k;
+        v[k]=q;
+        z[k]=s;
+        z[k+1]=inf;
+    }
+    if(empty) return;
+    k=0;
+    for(size_t q=0;q<n;++q){
+        float pq=q*step;
+        while(z[k+1]<pq) ++k;
+        float dp=pq-v[k]*step;
+        d[q]=dp*dp+f[v[k]*stride];
+    }
+    for(size_t q=0;q<n;++q){
+        f[q*stride]=d[q];
+    }
+}
+
+} // namespace move4d
@@ -4,33 +4,21 @@
 #include <move4d/utils/Geometry.h>
 #include <move4d/API/project.hpp>
 #include <move4d/planner/cost_space.hpp>
-#include <move4d/utils/multiHandOver/SimpleGraph.h>
-#include <move4d/utils/multiHandOver/graphAlgorithms.h>
 
 namespace move4d { namespace LocationIndicator{
 
-template<typename T>
-class NodeBase : public mho::Node
-{
-public:
-    using reference = T&;
-    using const_reference = T const &;
-    using data_type = T;
-
-    NodeBase(const_reference data):
-        mho::Node(),
-        data(data)
-    { }
-
-    const_reference getData() const { return data;}
-    void setData(const data_type &value){data=value;}
-
-private:
-    data_type data;
-};
-
 LocationIndicatorPlanner* LocationIndicatorPlanner::__instance = new LocationIndicatorPlanner();
 
+namespace {
+/// PlanningData::run() throws the cost of its result when it is not valid (e.g. all the routes are too long)
+void reportNoSolution(const std::vector<Robot*> &references, double cost)
+{
+    for(Robot *reference : references){
+        std::cout<<"no solution for reference "<<reference->getName()<<" (best cost "<<cost<<")"<<std::endl;
+    }
+}
+}
+
 LocationIndicatorPlanner::LocationIndicatorPlanner()
 {
     _deps.push_back("Entities");
@@ -48,55 +36,83 @@ void LocationIndicatorPlanner::loadRouteGraph()
 {
     API::Parameter::lock_t lock;
     API::Parameter &param=API::Parameter::root(lock)["LocationIndicator"]["routes"];
+    std::vector<std::string> names;
     for(uint i=0 ; i<param["nodes"].size() ; ++i){
-        mRouteGraph->addNode(new NodeBase<API::Parameter>(param["nodes"][i]));
+        if(param["nodes"][i].hasKey("name"))
+            names.push_back(param["nodes"][i]["name"].asString());
+        else
+            names.push_back(std::string());
     }
-
+    std::vector<RouteTimes::Edge> edges;
     for(uint i=0 ; i<param["edges"].size() ; ++i){
         API::Parameter &e=param["edges"][i];
-        mRouteGraph->connectNodes(mRouteGraph->at(e["from"].asInt()),mRouteGraph->at(e["to"].asInt()),e["cost"].asDouble());
+        edges.push_back(RouteTimes::Edge{uint(e["from"].asInt()),uint(e["to"].asInt()),float(e["cost"].asDouble())});
     }
 
+    //the route times only depend on the number of nodes and on the edges
+    bool same = mRoutesLoaded && names.size()==mRouteNodeNames.size() && edges.size()==mRouteEdges.size();
+    for(size_t i=0;same && i<edges.size();++i){
+        same = edges[i].from==mRouteEdges[i].from && edges[i].to==mRouteEdges[i].to && edges[i].time==mRouteEdges[i].time;
+    }
+    mRouteNodeNames.swap(names);
+    if(same) return;
+    mRouteEdges.swap(edges);
+    mRouteTimes=RouteTimes(mRouteNodeNames.size(),mRouteEdges);
+    mRoutesLoaded=true;
 }
 
-void LocationIndicatorPlanner::findHumanOnly(TargetInformation &target)
+int LocationIndicatorPlanner::routeNode(const std::string &name) const
 {
-    const double max_pointing_cost = 1.;
-    std::vector<PlanningData::Cell> costs;
-    uint best=-1u;
-    PlanningData::Cell best_cell({{0,0,0,0}},{{0,0,0,0}});
-    RobotState robot_state,human_state;
+    if(name.empty()) return -1;
+    for(uint i=0;i<mRouteNodeNames.size();++i){
+        if(mRouteNodeNames[i]==name) return i;
+    }
+    return -1;
+}
 
-    for(uint i =0; i<target.references.size();++i){
-        PlanningData plan(target.robot,target.human);
-        plan.targets.assign(1,target.references[i].first);
-        plan.max_dist=50.;
-        plan.mr=0.f;
-        plan.mh=1.f;
-        plan.ka=0.f;
-        plan.kp=0.f;
-        plan.vis_threshold=0.5f;
+float LocationIndicatorPlanner::routeTime(const std::string &from, const std::string &to) const
+{
+    int i=routeNode(from), j=routeNode(to);
+    if(i<0 || j<0) return -1.f;
+    return mRouteTimes.time(i,j);
+}
 
-        costs.push_back(plan.run(false));
-        costs.back().cost.cost(PlanningData::Cost::Costs::COST)+=std::pow(plan.kt*target.references[i].second,2.) +
-                std::pow(plan.ktr*target.references[i].second,2.);
-        costs.back().cost.cost(PlanningData::Cost::Costs::TIME) += target.references[i].second;
-        if(best==-1u || costs.back() < best_cell){
-            best=i;
-            best_cell=costs.back();
-            human_state=*target.human->getCurrentPos();
-            robot_state=*target.robot->getCurrentPos();
-        }
+void LocationIndicatorPlanner::findHumanOnly(TargetInformation &target)
+{
+    if(target.references.empty()){
+        std::cout<<"no DIY solution found"<<std::endl;
+        return;
     }
-    if(best!=-1u && best_cell.cost.toDouble() < 1000.){
-        //found a good place for the human
-        std::cout << "human goes at "<<best_cell.getPos(1).transpose()<<" and will see "<<target.references[best].first->getName()<<
-                     " at "<< m3dGeometry::getConfBase2DPos(*target.references[best].first->getCurrentPos()).transpose() <<std::endl;
-        target.human->setAndUpdate(human_state);
-        target.robot->setAndUpdate(robot_state);
-    }else if(best!=-1u){
-        std::cout<<"DIY solution has cost "<<best_cell.cost.toDouble()<<" -> discarding"<<std::endl;
-    }else{
+    //one search for all the references, each cell keeps the best one
+    PlanningData plan(target.robot,target.human);
+    plan.targets.clear();
+    plan.routeDirTimes.clear();
+    for(auto it : target.references){
+        plan.targets.push_back(it.first);
+        plan.routeDirTimes.push_back(it.second);
+    }
+    plan.indexFirstOptionalTarget=plan.targets.size();
+    plan.anyTarget=true;
+    plan.max_dist=50.;
+    plan.mr=0.f;
+    plan.mh=1.f;
+    plan.ka=0.f;
+    plan.kp=0.f;
+    plan.vis_threshold=0.5f;
+
+    //the agents are left at the solution
+    try{
+        PlanningData::Cell best_cell=plan.run(false);
+        uint best=best_cell.target;
+        if(best_cell.cost.toDouble() < 1000.){
+            //found a good place for the human
+            std::cout << "human goes at "<<best_cell.getPos(1).transpose()<<" and will see "<<target.references[best].first->getName()<<
+                         " at "<< m3dGeometry::getConfBase2DPos(*target.references[best].first->getCurrentPos()).transpose() <<std::endl;
+        }else{
+            std::cout<<"DIY solution has cost "<<best_cell.cost.toDouble()<<" -> discarding"<<std::endl;
+        }
+    }catch(double cost){
+        reportNoSolution(plan.targets,cost);
         std::cout<<"no DIY solution found"<<std::endl;
     }
 }
@@ -136,16 +152,16 @@ void LocationIndicatorPlanner::pointFromInit(TargetInformation &target, Robot *o
     plan.ka=0.f;
     plan.kp=0.f;
     plan.vis_threshold=0.f;
-    plan.run(false);
+    try{
+        plan.run(false);
+    }catch(double cost){
+        reportNoSolution(plan.targets,cost);
+    }
 }
 
 void LocationIndicatorPlanner::run(TargetInformation &target)
 {
     const double max_pointing_cost = 50.;
-    std::vector<PlanningData::Cell> costs;
-    uint best=-1u;
-    PlanningData::Cell best_cell({{0,0,0,0}},{{0,0,0,0}});
-    RobotState robot_state,human_state;
 
     Robot *best_target_init =
             isTargetVisibleFromInit(target);
@@ -162,27 +178,33 @@ void LocationIndicatorPlanner::run(TargetInformation &target)
         findHumanOnly(target);
     }else{
         std::cout<<"do some more effort in showing the target to the human"<<std::endl;
-        for(uint i =0; i<target.references.size();++i){
-            PlanningData plan(target.robot,target.human);
-            plan.getParameters();
-            plan.targets.assign(1,target.references[i].first);
-            costs.push_back(plan.run(false));
-            costs.back().cost.cost(PlanningData::Cost::Costs::COST)+=std::pow(plan.kt*target.references[i].second,2.) +
-                    std::pow(plan.ktr*target.references[i].second,2.);
-            costs.back().cost.cost(PlanningData::Cost::Costs::TIME)+=target.references[i].second;
-            if(best==-1u || costs.back() < best_cell){
-                best=i;
-                best_cell=costs.back();
-                human_state=*target.human->getCurrentPos();
-                robot_state=*target.robot->getCurrentPos();
+        if(target.references.empty()){
+            return;
+        }
+        //one search for all the references, each cell keeps the best one with its route time
+        PlanningData plan(target.robot,target.human);
+        plan.getParameters();
+        plan.targets.clear();
+        plan.routeDirTimes.clear();
+        for(auto it : target.references){
+            plan.targets.push_back(it.first);
+            plan.routeDirTimes.push_back(it.second);
+        }
+        plan.indexFirstOptionalTarget=plan.targets.size();
+        plan.anyTarget=true;
+        //the agents are left at the solution
+        bool found=false;
+        try{
+            PlanningData::Cell best_cell=plan.run(false);
+            if(best_cell.cost.toDouble() < max_pointing_cost){
+                //found a good pointing solution
+                std::cout<<"found good pointing for target "<<target.references[best_cell.target].first->getName()<<std::endl;
+                found=true;
             }
+        }catch(double cost){
+            reportNoSolution(plan.targets,cost);
         }
-        if(best_cell.cost.toDouble() < max_pointing_cost){
-            //found a good pointing solution
-            std::cout<<"found good pointing for target "<<target.references[best].first->getName()<<std::endl;
-            target.human->setAndUpdate(human_state);
-            target.robot->setAndUpdate(robot_state);
-        }else{
+        if(!found){
             std::cout<<"no pointing found, search DIY solution"<<std::endl;
             findHumanOnly(target);
         }
@@ -199,10 +221,15 @@ void LocationIndicatorPlanner::runCompare(TargetInformation &target)
         plan.targets.push_back(it.first);
         plan.routeDirTimes.push_back(it.second);
     }
-    PlanningData::Cell cell = plan.run(false);
-    std::cout<<"found good pointing for target "<<target.references[cell.target].first->getName();
-    std::cout<<"\ncost="<<cell.cost.cost(PlanningData::MyCosts::COST)<<
-               "\ntime="<<cell.cost.cost(PlanningData::MyCosts::TIME)<<std::endl;
+    try{
+        PlanningData::Cell cell = plan.run(false);
+        std::cout<<"found good pointing for target "<<target.references[cell.target].first->getName();
+        std::cout<<"\ncost="<<cell.cost.cost(PlanningData::MyCosts::COST)<<
+                   "\ntime="<<cell.cost.cost(PlanningData::MyCosts::TIME)<<std::endl;
+    }catch(double cost){
+        reportNoSolution(plan.targets,cost);
+        return;
+    }
 
     std::cout <<"post compute cost="<<plan.computeStateCost(*plan.r->getCurrentPos())<<std::endl;
 }
@@ -215,10 +242,13 @@ void LocationIndicatorPlanner::run()
 
     std::vector<std::pair<Robot*,float> > targets;
     API::Parameter ptargets;
+    std::string destination; // name of the route node of the location to indicate
     TargetInformation data;
     {
     API::Parameter::lock_t lock;
     ptargets = API::Parameter::root(lock)["LocationIndicator"]["references"];
+    if(API::Parameter::root(lock)["LocationIndicator"].hasKey("destination"))
+        destination=API::Parameter::root(lock)["LocationIndicator"]["destination"].asString();
     data.known=API::Parameter::root(lock)["LocationIndicator"]["known"].asBool();
     data.see_first=API::Parameter::root(lock)["LocationIndicator"]["see_first"].asBool();
     // data.positionPhysicalTarget[0]=API::Parameter::root(lock)["LocationIndicator"]["physical_target_pos"][0].asDouble();
@@ -226,8 +256,19 @@ void LocationIndicatorPlanner::run()
     }
     loadRouteGraph();
     for(uint i=0;i<ptargets.size();++i){
-        targets.push_back(std::make_pair(global_Project->getActiveScene()->getRobotByName(ptargets[i]["name"].asString()),
-                          float(ptargets[i]["dir_cost"].asDouble())));
+        std::string name=ptargets[i]["name"].asString();
+        float dir_cost;
+        if(ptargets[i].hasKey("dir_cost")){
+            dir_cost=ptargets[i]["dir_cost"].asDouble();
+        }else{
+            //time of the route from the reference to the destination
+            dir_cost=routeTime(name,destination);
+            if(dir_cost<0.f){
+                std::cout<<"no route from "<<name<<" to the destination \""<<destination<<"\", no direction cost"<<std::endl;
+                dir_cost=0.f;
+            }
+        }
+        targets.push_back(std::make_pair(global_Project->getActiveScene()->getRobotByName(name),dir_cost));
         assert(targets.back().first);//not null
     }
     data.human=h;
@@ -7,7 +7,11 @@
 #include <move4d/API/Grids/NDGridAlgo.hpp>
 #include "VisibilityGrid/VisibilityGrid.hpp"
 #include "VisibilityGrid/VisibilityGridLoader.hpp"
+#include "VisibilityGrid/WorkerPool.hpp"
+#include "VisibilityGrid/DistanceTransform.hpp"
+#include "VisibilityGrid/RegionMap.hpp"
 #include <libmove3d/util/proto/p3d_angle_proto.h>
+#include <libmove3d/P3d-pkg.h>
 
 #include <move4d/API/Device/objectrob.hpp>
 #include <move4d/utils/Geometry.h>
@@ -16,10 +20,25 @@
 #include <move4d/API/Graphic/DrawablePool.hpp>
 #include <move4d/API/Collision/collisionInterface.hpp>
 #include <move4d/API/Collision/CylinderCollision.hpp>
+#include <move4d/database/DatabaseReader.hpp>
 
 #include <boost/bind.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/serialization/vector.hpp>
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <list>
+#include <mutex>
+#include <random>
+#include <sstream>
 #include <stdlib.h>     /* srand, rand */
 #include <time.h>       /* time */
 
@@ -31,6 +50,32 @@ namespace move4d {
 
 INIT_MOVE3D_STATIC_LOGGER(PlanningData,"move4d.visibilitygrid.pointingplanner.data");
 
+/// the cylinders used for collision checks are shared scene objects
+static std::mutex collisionMutex;
+
+namespace {
+/// bilinear interpolation at pos of the values get(x,y) at the cell centers of grid.
+/// Next to an infinite value (an obstacle) the value of the cell containing pos is returned. Throws out_of_grid.
+template<typename T, typename Get>
+float bilinear(const API::nDimGrid<T,2> &grid, const Eigen::Vector2d &pos, const Get &get)
+{
+    typename API::nDimGrid<T,2>::SpaceCoord p{{float(pos[0]),float(pos[1])}};
+    typename API::nDimGrid<T,2>::ArrayCoord c=grid.getCellCoord(p);
+    typename API::nDimGrid<T,2>::ArrayCoord last=grid.getCellCoord(grid.getNumberOfCells()-1);
+    typename API::nDimGrid<T,2>::SpaceCoord center=grid.getCellCenter(c);
+    float tx=(p[0]-center[0])/grid.getCellSize()[0], ty=(p[1]-center[1])/grid.getCellSize()[1];
+    long x0=c[0], y0=c[1];
+    long x1=x0+(tx>=0.f ? 1 : -1), y1=y0+(ty>=0.f ? 1 : -1);
+    if(x1<0 || x1>long(last[0])) x1=x0;
+    if(y1<0 || y1>long(last[1])) y1=y0;
+    tx=std::abs(tx);
+    ty=std::abs(ty);
+    float v00=get(x0,y0), v10=get(x1,y0), v01=get(x0,y1), v11=get(x1,y1);
+    if(!std::isfinite(v00+v10+v01+v11)) return v00;
+    return (1.f-ty)*((1.f-tx)*v00+tx*v10) + ty*((1.f-tx)*v01+tx*v11);
+}
+}
+
 struct CompareCellPtr
 {
     bool operator()(PlanningData::Cell *const &a,PlanningData::Cell *const &b){
@@ -41,13 +86,47 @@ struct CompareCellPtr
 PlanningData::Cell PlanningData::run(bool read_parameters)
 {
     M3D_DEBUG("PointingPlanner::run start");
-    ENV.setBool(Env::isRunning,true);
+    steady_clock::time_point run_start = steady_clock::now();
+    //a run on a snapshot leaves the shared state untouched
+    if(!snapshot) ENV.setBool(Env::isRunning,true);
     if(read_parameters) getParameters();
+    //the same query as a previous one: its result is published again without planning
+    resultKey=0;
+    if(resultCacheSize && !snapshot && group.empty()){
+        updateAgentFrames();
+        resultKey=resultCacheKey();
+        std::shared_ptr<const CachedResult> cached=findCachedResult(resultKey);
+        if(cached){
+            Cell best=cached->best;
+            alternatives=cached->alternatives;
+            status=cached->status;
+            status.cached=true;
+            status.elapsed=duration_cast<duration<double>>(steady_clock::now()-run_start).count();
+            M3D_DEBUG("PointingPlanner::run result found in the cache");
+            //the state a planning run leaves: the precomputation of this query, and the result to repair at the next one
+            this->resetFromCurrentInitPos();
+            publishResult(best,cached.get());
+            lastBest=best.coord;
+            hasLastBest=true;
+            ENV.setBool(Env::isRunning,false);
+            return best;
+        }
+    }
+    if(!group.empty()){
+        //the other humans are read from the scene
+        if(!snapshot) return runGroup(run_start);
+        M3D_INFO("PointingPlanner::run the group mode does not run on a snapshot, planning for "<<h->getName()<<" only");
+    }
+    if(engine==Engine::SAMPLING) return runSampling(run_start);
+    status=RunStatus();
+    return runLattice(run_start,regionPruning);
+}
+
+PlanningData::Cell PlanningData::runLattice(steady_clock::time_point run_start, bool prune_regions)
+{
     this->resetFromCurrentInitPos();
     balls->balls_values.clear();
     VisibilityGrid3d *vis_grid=dynamic_cast<VisibilityGridLoader*>(ModuleRegister::getInstance()->module(VisibilityGridLoader::name()))->grid();
-    CompareCellPtr comp;
-    std::vector<Cell*> open_heap;
     VisibilityGrid3d::SpaceCoord vis_cell_size=vis_grid->getCellSize();
     //API::MultiGrid<float,vis_size[0],vis_size[1],vis_size[0],vis_size[1]> grid;
     Grid::SpaceCoord cell_size;
@@ -60,48 +139,846 @@ PlanningData::Cell PlanningData::run(bool read_parameters)
     envSize[3]=envSize[7]=global_Project->getActiveScene()->getBounds()[3]; //y max
 
     bool adjust=false;
+    regionCells_r.clear();
+    regionCells_h.clear();
+    std::vector<double> sceneSize=envSize;
+    if(prune_regions && !restrictToRegions(envSize)){
+        envSize=sceneSize;
+    }
     Grid grid(cell_size,adjust,envSize);
+    if(!computeLatticeOffset(grid) && !regionCells_h.empty()){
+        M3D_INFO("PointingPlanner::run the lattice restricted to the regions does not match the freespace grids, using the whole scene");
+        regionCells_r.clear();
+        regionCells_h.clear();
+        grid=Grid(cell_size,adjust,sceneSize);
+        computeLatticeOffset(grid);
+    }
     r=global_Project->getActiveScene()->getActiveRobot();
     assert(this->h);
+    updateAgentFrames();
+    LatticeTermsKey terms_key=latticeTermsKey(grid);
+    if(!incremental || terms_r.terms.empty() || !(terms_key==latticeTerms)){
+        resetLatticeTerms(grid);
+        pairTerms.clear();
+        hasLastBest=false;
+        latticeTerms=terms_key;
+    }
     //h=global_Project->getActiveScene()->getRobotByNameContaining("HUMAN");
 
     Grid::ArrayCoord coord;
     Grid::SpaceCoord pos;
     Eigen::Vector2d from;
     for(uint i=0;i<2;++i){
-        from[i]=pos[0+i]=r->getInitialPosition()->at(6+i);
-        pos[2+i]=h->getInitialPosition()->at(6+i);
+        from[i]=pos[0+i]=start_r[6+i];
+        pos[2+i]=start_h[6+i];
     }
 
     coord=grid.getCellCoord(pos);
     Cell *start=createCell(coord,grid.getCellCenter(coord));
-    start->open=true;
     grid.getCell(coord)=start;
-    open_heap.push_back(start);
-    std::push_heap(open_heap.begin(),open_heap.end(),comp);
 
+    std::vector<Cell*> seeds{start};
+    std::vector<Cell*> created{start};
     Cell *best=start;
-    uint count(0);
-    uint iter_of_best{0};
-
-    unsigned int neighbours_number = grid.neighboursNumber();
-    unsigned int i=0;
-    Cell *c;
-    bool found_best = false;
+    if(incremental && hasLastBest && lastBest!=coord){
+        //repair the previous solution: it is expanded first
+        Cell *seed=new Cell(lastBest,grid.getCellCenter(lastBest));
+        seed->col=0;
+        bool seeded=false;
+        try{
+            if(!isTooFar(seed,start)){
+                prepareLatticeTerms(seed);
+                computeCostFactorized(seed,mainContext,&latticePairTerms(seed));
+                seeded=true;
+            }
+        }catch(Grid::out_of_grid &e){
+        }
+        if(seeded){
+            grid.getCell(lastBest)=seed;
+            seeds.push_back(seed);
+            created.push_back(seed);
+            if(seed->cost < best->cost) best=seed;
+        }else{
+            delete seed;
+        }
+    }
 
     srand (time(NULL));
     high_resolution_clock::time_point t1 = high_resolution_clock::now();
 
-    for(count=0;count<160000 && open_heap.size();++count){
+    WorkerPool pool(threads);
+    std::vector<EvalContext> contexts(pool.size());
+    LatticeSearch search;
+    search.grid=&grid;
+    search.start=start;
+    search.best=best;
+    search.pool=&pool;
+    search.contexts=&contexts;
+    search.created.swap(created);
+    //the preparation of the grids above counts in the deadline
+    search.deadline_time = run_start + duration_cast<steady_clock::duration>(duration<double>(deadline));
+
+    std::vector<char> human_visible;
+    if(visibilityPruning && computeHumanVisibleCells(grid,start,human_visible)){
+        search.humanVisible=&human_visible;
+    }
+
+    //coarse to fine: each pass refines around the best cells of the previous one
+    bool full_pass=(multiresLevels==0); // the last search visited all the cells
+    auto search_passes=[&](){
+        full_pass=(multiresLevels==0);
+        SearchPass pass;
+        pass.stride = 1u<<multiresLevels;
+        pass.seeds = seeds;
+        for(uint level=multiresLevels;;--level){
+            pass.candidates = (level ? multiresCandidates : 1);
+            std::vector<Cell*> candidates=searchPass(search,pass);
+            if(level==0 || search.stopped) break;
+            pass.stride = 1u<<(level-1);
+            pass.radius = 1u<<level;
+            pass.windows.clear();
+            pass.seeds.clear();
+            for(auto it=candidates.rbegin();it!=candidates.rend();++it){
+                //the best is expanded first
+                pass.windows.push_back((*it)->coord);
+                pass.seeds.push_back(*it);
+            }
+        }
+        if(multiresLevels && !search.stopped && !search.best->cost.isValid()){
+            //a coarse cell only samples the center of the block it covers, the narrow valid regions may be missed
+            M3D_INFO("PointingPlanner::run no valid solution with the coarse levels, searching all the cells");
+            SearchPass fine;
+            fine.seeds = seeds;
+            searchPass(search,fine);
+            full_pass=true;
+        }
+    };
+    search_passes();
+    if(search.humanVisible && !search.stopped && search.best->cost.constraint(MyConstraints::VIS)>0.f){
+        //no visible solution among the pruned cells, search again with all of them as before
+        M3D_INFO("PointingPlanner::run no solution with the visibility pruning, searching again without it");
+        search.humanVisible=nullptr;
+        for(Cell *t : search.transit){
+            computeCostFactorized(t,mainContext,(incremental ? &latticePairTerms(t) : nullptr));
+        }
+        search.transit.clear();
+        search_passes();
+    }
+    best=search.best;
+    uint count=search.count;
+    uint iter_of_best=search.iter_of_best;
+
+    status.expansions+=count;
+    if(!regionCells_h.empty() && !search.stopped && !best->cost.isValid()){
+        //the kept regions may not connect the start to every placement, search again as without the pruning
+        //(the counts and the deadline include the pruned search)
+        M3D_INFO("PointingPlanner::run no solution with the region pruning, searching again on the whole scene");
+        for(Cell *cell : search.created){
+            delete cell;
+        }
+        return runLattice(run_start,false);
+    }
+    status.completed=!status.deadline_reached && !status.cancelled;
+    if(status.completed && search.exhaustive && full_pass){
+        //every reachable cell was evaluated, the best is the optimum
+        status.gap=0.f;
+    }
+    status.elapsed=duration_cast<duration<double>>(steady_clock::now()-run_start).count();
+    if(status.deadline_reached){
+        M3D_INFO("PointingPlanner::run deadline reached after "<<status.expansions<<" expansions, returning the best so far");
+    }else if(status.cancelled){
+        M3D_INFO("PointingPlanner::run cancelled after "<<status.expansions<<" expansions, returning the best so far");
+    }
+    //visibEngine->finish();
+    high_resolution_clock::time_point t2 = high_resolution_clock::now();
+    duration<double> time_span = duration_cast<duration<double>>(t2 - t1);
+
+    std::cout << "It took me " << time_span.count() << std::endl;
+
+    alternatives.clear();
+    for(Cell *a : search.alternatives){
+        alternatives.push_back(*a);
+    }
+    if(refine){
+        refineCell(*best,*search.start);
+        for(Cell &a : alternatives) refineCell(a,*search.start);
+        status.refined=true;
+    }
+    M3D_DEBUG("done "<<best->cost.toDouble()<<" found at iteration #"<<iter_of_best
+              <<"\nit: "<<count<<" / "<<grid.getNumberOfCells()
+              <<"\ntarget: "<<targets[best->target]->getName()
+              <<"\n\tCcol="<<best->cost.constraint(MyConstraints::COL)
+              <<"\n\tCvis="<<best->cost.constraint(MyConstraints::VIS)
+              <<"\n\tcost="<<best->cost.cost(MyCosts::COST)
+              <<"\n\ttime="<<best->cost.cost(MyCosts::TIME)
+              );
+    publishResult(*best);
+
+    Cell best_copy=*best;
+    lastBest=best->coord;
+    hasLastBest=true;
+    for(Cell *cell : search.created){
+        delete cell;
+    }
+    if(!snapshot) ENV.setBool(Env::isRunning,false);
+    M3D_DEBUG("PointingPlanner::run end");
+    if(!best_copy.cost.isValid()){
+        M3D_INFO("PointingPlanner::run invalid solution");
+        throw best_copy.cost.toDouble();
+    }
+
+    return best_copy;
+}
+
+PlanningData::Cell PlanningData::runSampling(steady_clock::time_point run_start)
+{
+    this->resetFromCurrentInitPos();
+    balls->balls_values.clear();
+    updateAgentFrames();
+    status=RunStatus();
+    alternatives.clear();
+    const float inf=std::numeric_limits<float>::infinity();
+    const uint batch=256; //evaluated in parallel, the deadline and the cancellation are checked between batches
+    const uint elites=10; //cells refined by the local search
+    const uint rounds=4;
+    const float min_weight=0.05f; //of a human position where the targets are hidden
+    steady_clock::time_point deadline_time = run_start + duration_cast<steady_clock::duration>(duration<double>(deadline));
+
+    Grid::ArrayCoord no_coord{{0,0,0,0}};
+    Grid::SpaceCoord start_pos;
+    for(uint i=0;i<2;++i){
+        start_pos[i]=start_r[6+i];
+        start_pos[2+i]=start_h[6+i];
+    }
+    Cell start(no_coord,start_pos);
+    start.col=0;
+    computeCost(&start,mainContext);
+    ++status.evaluations;
+    std::vector<Cell> best(1,start); //the elites, sorted
+
+    std::mt19937 rng(samplingSeed);
+    std::uniform_real_distribution<float> uniform(0.f,1.f);
+    std::normal_distribution<float> normal(0.f,1.f);
+
+    //importance of a human position: 1 if it sees the mandatory targets (one of them in any target mode), less otherwise
+    bool any_target = anyTarget && indexFirstOptionalTarget>0;
+    AgentTerms terms;
+    std::vector<float> visib;
+    auto human_weight=[&](const Eigen::Vector2d &ph){
+        try{
+            computeAgentTerms(1,ph,terms,visib);
+        }catch(std::out_of_range &){
+            return 0.f;
+        }
+        if(!terms.free || !std::isfinite(terms.dist)) return 0.f;
+        float v = (any_target ? inf : 0.f);
+        for(uint i=0;i<indexFirstOptionalTarget;++i){
+            v = (any_target ? std::min(v,visib[i]) : std::max(v,visib[i]));
+        }
+        if(indexFirstOptionalTarget==0 || v<=vis_threshold) return 1.f;
+        return std::max(min_weight,1.f-v);
+    };
+    auto sample=[&](){
+        Cell c(no_coord,start_pos);
+        c.col=0;
+        for(uint attempt=0;attempt<20;++attempt){
+            //human drawn uniformly in reach, kept according to its weight
+            Eigen::Vector2d ph=start.vPosHuman();
+            if(mh>0.f){
+                float d=max_dist*std::sqrt(uniform(rng)), a=2*M_PI*uniform(rng);
+                ph+=Eigen::Vector2d(d*std::cos(a),d*std::sin(a));
+            }
+            if(uniform(rng) > human_weight(ph)) continue;
+            //robot around the human at the proxemics distance
+            Eigen::Vector2d pr=start.vPosRobot();
+            if(mr>0.f){
+                float d=std::max(0.f,dp+prox_tol*normal(rng)), a=2*M_PI*uniform(rng);
+                pr=ph+Eigen::Vector2d(d*std::cos(a),d*std::sin(a));
+            }
+            for(uint i=0;i<2;++i){
+                c.pos[i]=pr[i];
+                c.pos[2+i]=ph[i];
+            }
+            if(!isTooFar(&c,&start)) break;
+        }
+        return c;
+    };
+    auto stop=[&](){
+        if(deadline>0.f && steady_clock::now() >= deadline_time){
+            status.deadline_reached=true;
+            return true;
+        }
+        if(cancelled && cancelled()){
+            status.cancelled=true;
+            return true;
+        }
+        return false;
+    };
+
+    WorkerPool pool(threads);
+    std::vector<EvalContext> contexts(pool.size());
+    std::vector<Cell> cells;
+    //evaluate cells in parallel and keep the best ones
+    auto evaluate=[&](){
+        pool.parallelFor(cells.size(),[&](size_t i,unsigned int worker){
+            Cell &c=cells[i];
+            try{
+                if(!isTooFar(&c,&start)){
+                    computeCost(&c,contexts[worker]);
+                    return;
+                }
+            }catch(std::out_of_range &){
+            }
+            c.cost.constraint(MyConstraints::COL)=inf;
+            c.col=true;
+            c.target=0;
+        });
+        status.evaluations+=cells.size();
+        for(const Cell &c : cells){
+            auto it=std::upper_bound(best.begin(),best.end(),c);
+            if(size_t(it-best.begin())<elites){
+                best.insert(it,c);
+                if(best.size()>elites) best.pop_back();
+            }
+        }
+        ++status.expansions;
+        if(progress) progress(Progress{status.expansions,float(best[0].cost.toDouble())});
+        cells.clear();
+    };
+
+    //global phase: samplingSamples placements drawn over the reachable area
+    bool stopped=false;
+    for(uint n=0;n<samplingSamples && !stopped;){
+        for(;n<samplingSamples && cells.size()<batch;++n){
+            cells.push_back(sample());
+        }
+        evaluate();
+        stopped=stop();
+    }
+    //local phase: half as many placements around the elites, closer at each round
+    float sigma=2*pre->freespace_h.getCellSize()[0]*(1u<<(rounds-1));
+    for(uint round=0;round<rounds && !stopped;++round,sigma/=2){
+        uint per_elite=std::max<uint>(1,samplingSamples/2/rounds/best.size());
+        std::vector<Cell> centers=best;
+        for(const Cell &center : centers){
+            for(uint k=0;k<per_elite;++k){
+                Cell c(no_coord,center.pos);
+                c.col=0;
+                for(uint d=0;d<4;++d){
+                    bool moves = (d<2 ? mr>0.f : mh>0.f);
+                    if(moves) c.pos[d]+=sigma*normal(rng);
+                }
+                cells.push_back(c);
+            }
+        }
+        evaluate();
+        stopped=stop();
+    }
+
+    if(refine){
+        refineCell(best[0],start);
+        status.refined=true;
+    }
+    status.completed=!status.deadline_reached && !status.cancelled;
+    status.elapsed=duration_cast<duration<double>>(steady_clock::now()-run_start).count();
+    M3D_DEBUG("PointingPlanner::runSampling done "<<best[0].cost.toDouble()<<" after "<<status.evaluations<<" evaluations");
+    publishResult(best[0]);
+    if(!snapshot) ENV.setBool(Env::isRunning,false);
+    if(!best[0].cost.isValid()){
+        M3D_INFO("PointingPlanner::runSampling invalid solution");
+        throw best[0].cost.toDouble();
+    }
+    return best[0];
+}
+
+PlanningData::Cell PlanningData::runGroup(steady_clock::time_point run_start)
+{
+    this->resetFromCurrentInitPos();
+    balls->balls_values.clear();
+    updateAgentFrames();
+    status=RunStatus();
+    alternatives.clear();
+    groupResult.clear();
+    const float inf=std::numeric_limits<float>::infinity();
+    const uint batch=256; //robot positions evaluated in parallel, the deadline and the cancellation are checked between batches
+    steady_clock::time_point deadline_time = run_start + duration_cast<steady_clock::duration>(duration<double>(deadline));
+
+    //the grids of each human: collision, distances from its start and visibilities from its perspective
+    groupPlans.resize(group.size());
+    std::vector<PlanningData*> plans{this};
+    for(uint k=0;k<group.size();++k){
+        std::unique_ptr<PlanningData> &plan=groupPlans[k];
+        if(!plan || plan->cyl_h!=group[k]->getObjectRob()->getCylinder()){
+            plan.reset(new PlanningData(r,group[k]));
+        }
+        plan->getParameters();
+        plan->group.clear();
+        plan->h=group[k];
+        //may have been set by the caller rather than read from the parameters
+        plan->targets=targets;
+        plan->indexFirstOptionalTarget=indexFirstOptionalTarget;
+        plan->anyTarget=anyTarget;
+        plan->routeDirTimes=routeDirTimes;
+        plan->resetFromCurrentInitPos();
+        plan->updateAgentFrames();
+        plans.push_back(plan.get());
+    }
+
+    Grid::ArrayCoord no_coord{{0,0,0,0}};
+    std::vector<Cell> starts;
+    for(PlanningData *plan : plans){
+        Grid::SpaceCoord pos;
+        for(uint i=0;i<2;++i){
+            pos[i]=start_r[6+i];
+            pos[2+i]=plan->start_h[6+i];
+        }
+        starts.push_back(Cell(no_coord,pos));
+    }
+
+    //positions of each human: in reach, where it sees the mandatory targets first, the closest first
+    bool any_target = anyTarget && indexFirstOptionalTarget>0;
+    std::vector<std::vector<Eigen::Vector2d> > candidates(plans.size());
+    for(uint k=0;k<plans.size();++k){
+        const Precomputation &hpre=*plans[k]->pre;
+        std::vector<const std::vector<float>*> slices;
+        for(uint i=0;i<indexFirstOptionalTarget;++i){
+            slices.push_back(&plans[k]->pre->visibilitySlice(1,targets[i]));
+        }
+        std::vector<std::pair<std::pair<bool,float>,size_t> > cells; //((hidden,dist),cell)
+        for(size_t i=0;i<hpre.freespace_h.getNumberOfCells() && mh>0.f;++i){
+            float dist=hpre.distGrid_h.getGrid().getCell(i);
+            if(!hpre.freespace_h.getCell(i) || !(dist<=max_dist)) continue;
+            API::nDimGrid<bool,2>::ArrayCoord c=hpre.freespace_h.getCellCoord(i);
+            bool sees = !any_target;
+            for(const std::vector<float> *slice : slices){
+                bool v=(*slice)[c[0]+hpre.nx*c[1]]<=vis_threshold;
+                sees = (any_target ? sees || v : sees && v);
+            }
+            cells.push_back(std::make_pair(std::make_pair(!sees,dist),i));
+        }
+        size_t n=std::min<size_t>(groupCandidates,cells.size());
+        std::partial_sort(cells.begin(),cells.begin()+n,cells.end());
+        //staying is always possible
+        candidates[k].push_back(starts[k].vPosHuman());
+        for(size_t j=0;j<n;++j){
+            API::nDimGrid<bool,2>::SpaceCoord p=hpre.freespace_h.getCellCenter(hpre.freespace_h.getCellCoord(cells[j].second));
+            candidates[k].push_back(Eigen::Vector2d(p[0],p[1]));
+        }
+    }
+
+    //positions of the robot: in reach (as isTooFar())
+    std::vector<Eigen::Vector2d> robot_cells{starts[0].vPosRobot()};
+    const float reach_r=std::min(max_dist,max_time_r*sr/2);
+    for(size_t i=0;i<pre->freespace_r.getNumberOfCells() && mr>0.f;++i){
+        if(!pre->freespace_r.getCell(i) || !(pre->distGrid_r.getGrid().getCell(i)<=reach_r)) continue;
+        API::nDimGrid<bool,2>::SpaceCoord p=pre->freespace_r.getCellCenter(pre->freespace_r.getCellCoord(i));
+        robot_cells.push_back(Eigen::Vector2d(p[0],p[1]));
+    }
+
+    //cost of the group, and the placement of each human, for a robot position
+    struct Placement
+    {
+        Cost cost;
+        size_t robot_cell;
+        std::vector<Cell> cells; //one per plan
+    };
+    WorkerPool pool(threads);
+    std::vector<std::vector<EvalContext> > contexts;
+    for(uint k=0;k<plans.size();++k){
+        contexts.emplace_back(pool.size());
+    }
+    //the group cost: the worst constraint and the mean cost of the humans
+    auto group_cost=[&](const std::vector<const Cost*> &costs){
+        Cost cost;
+        for(const Cost *c : costs){
+            for(size_t i=0;i<c->constraints.size();++i){
+                cost.constraints[i]=std::max(cost.constraints[i],c->constraints[i]);
+            }
+            for(size_t i=0;i<c->costs.size();++i){
+                cost.costs[i]+=c->costs[i]/costs.size();
+            }
+        }
+        return cost;
+    };
+    //assignments tried for a robot position, bounds the search when the humans cannot be kept apart
+    const size_t max_nodes=20000;
+    auto place=[&](size_t ir,unsigned int worker){
+        //the cost of each human at each of its candidates, best first, and a lower bound of them
+        std::vector<std::vector<Cell> > options(plans.size());
+        std::vector<Cost> floors(plans.size());
+        for(uint k=0;k<plans.size();++k){
+            for(const Eigen::Vector2d &ph : candidates[k]){
+                Cell c(no_coord,starts[k].pos);
+                c.col=0;
+                for(uint i=0;i<2;++i){
+                    c.pos[i]=robot_cells[ir][i];
+                    c.pos[2+i]=ph[i];
+                }
+                try{
+                    if(plans[k]->isTooFar(&c,&starts[k])) continue;
+                    plans[k]->computeCost(&c,contexts[k][worker]);
+                }catch(std::out_of_range &){
+                    continue;
+                }
+                options[k].push_back(c);
+            }
+            std::sort(options[k].begin(),options[k].end());
+            Cost &floor=floors[k];
+            if(options[k].empty()){
+                floor.constraint(MyConstraints::COL)=inf;
+                continue;
+            }
+            floor=options[k].front().cost;
+            for(const Cell &c : options[k]){
+                for(size_t i=0;i<floor.constraints.size();++i) floor.constraints[i]=std::min(floor.constraints[i],c.cost.constraints[i]);
+                for(size_t i=0;i<floor.costs.size();++i) floor.costs[i]=std::min(floor.costs[i],c.cost.costs[i]);
+            }
+        }
+
+        //joint assignment of the humans at least groupSeparation apart: depth first, the best candidates first,
+        //a branch is cut when its bound (the floors of the humans not assigned yet) is not better than the best found
+        Placement placement{Cost(),ir,{}};
+        bool found=false;
+        size_t nodes=0;
+        std::vector<const Cell*> chosen(plans.size(),nullptr);
+        std::vector<const Cost*> costs(plans.size(),nullptr);
+        std::function<void(uint)> assign=[&](uint k){
+            if(k==plans.size()){
+                Cost cost=group_cost(costs);
+                if(!found || cost < placement.cost){
+                    found=true;
+                    placement.cost=cost;
+                    placement.cells.clear();
+                    for(const Cell *c : chosen) placement.cells.push_back(*c);
+                }
+                return;
+            }
+            for(const Cell &c : options[k]){
+                if(nodes>=max_nodes) return;
+                bool close=false;
+                for(uint j=0;j<k && !close;++j){
+                    close = (chosen[j]->vPosHuman()-c.vPosHuman()).norm()<groupSeparation;
+                }
+                if(close) continue;
+                ++nodes;
+                chosen[k]=&c;
+                costs[k]=&c.cost;
+                if(found){
+                    for(uint j=k+1;j<plans.size();++j) costs[j]=&floors[j];
+                    if(!(group_cost(costs) < placement.cost)) continue;
+                }
+                assign(k+1);
+            }
+        };
+        assign(0);
+        if(!found){
+            //no separated placement: each human stays, the group is in collision
+            for(uint k=0;k<plans.size();++k){
+                Cell c(no_coord,starts[k].pos);
+                c.cost.constraint(MyConstraints::COL)=inf;
+                c.col=true;
+                c.target=0;
+                placement.cells.push_back(c);
+            }
+            placement.cost.constraint(MyConstraints::COL)=inf;
+        }
+        return placement;
+    };
+
+    size_t evaluations_per_cell=0;
+    for(const std::vector<Eigen::Vector2d> &c : candidates) evaluations_per_cell+=c.size();
+    Placement best=place(0,0);
+    status.evaluations+=evaluations_per_cell;
+    std::vector<Placement> placements;
+    for(size_t first=1;first<robot_cells.size();first+=batch){
+        placements.assign(std::min<size_t>(batch,robot_cells.size()-first),Placement());
+        pool.parallelFor(placements.size(),[&](size_t i,unsigned int worker){
+            placements[i]=place(first+i,worker);
+        });
+        for(Placement &p : placements){
+            if(p.cost < best.cost) best=p;
+        }
+        status.evaluations+=evaluations_per_cell*placements.size();
+        ++status.expansions;
+        if(progress) progress(Progress{status.expansions,float(best.cost.toDouble())});
+        if(deadline>0.f && steady_clock::now() >= deadline_time){
+            status.deadline_reached=true;
+            break;
+        }
+        if(cancelled && cancelled()){
+            status.cancelled=true;
+            break;
+        }
+    }
+
+    status.completed=!status.deadline_reached && !status.cancelled;
+    status.elapsed=duration_cast<duration<double>>(steady_clock::now()-run_start).count();
+    M3D_DEBUG("PointingPlanner::runGroup done "<<best.cost.toDouble()<<" for "<<plans.size()<<" humans, "
+              <<robot_cells.size()<<" robot positions, after "<<status.evaluations<<" evaluations");
+    Cell result=best.cells[0];
+    result.cost=best.cost;
+    groupResult.assign(best.cells.begin()+1,best.cells.end());
+    //the humans of the group first, the robot ends oriented for h
+    for(uint k=0;k<group.size();++k){
+        groupPlans[k]->setRobots(r,group[k],&groupResult[k]);
+    }
+    publishResult(result);
+    {
+        API::Parameter::lock_t lock;
+        API::Parameter &groupParam = API::Parameter::root(lock)["PointingPlanner"]["result"]["group"];
+        groupParam=API::Parameter(API::Parameter::ArrayValue);
+        for(uint k=0;k<group.size();++k){
+            Cell &c=groupResult[k];
+            API::Parameter member;
+            member["human"]=API::Parameter(group[k]->getName());
+            member["position"]=API::Parameter(std::vector<API::Parameter>{double(c.pos[2]),double(c.pos[3])});
+            member["target"]=API::Parameter(targets[c.target]->getName());
+            member["cost"]=API::Parameter(c.cost.toDouble());
+            groupParam.append(member);
+        }
+    }
+    ENV.setBool(Env::isRunning,false);
+    if(!result.cost.isValid()){
+        M3D_INFO("PointingPlanner::runGroup invalid solution");
+        throw result.cost.toDouble();
+    }
+    return result;
+}
+
+void PlanningData::refineCell(Cell &c, Cell &start)
+{
+    const uint max_evaluations=200;
+    const float cell_size=pre->freespace_h.getCellSize()[0];
+    mainContext.interpolate=true;
+    Cell current(c);
+    uint evaluations=0;
+    try{
+        computeCost(&current,mainContext);
+        ++evaluations;
+        //compass search: the best of the moves along one axis, the step is halved when none improves
+        for(float step=cell_size/2; step>=cell_size/16 && evaluations<max_evaluations;){
+            Cell best_move(current);
+            for(uint d=0;d<4;++d){
+                for(float sign : {-1.f,1.f}){
+                    Cell n(current);
+                    n.pos[d]+=sign*step;
+                    if(isTooFar(&n,&start)) continue;
+                    try{
+                        computeCost(&n,mainContext);
+                    }catch(std::out_of_range &){
+                        continue;
+                    }
+                    ++evaluations;
+                    if(n.cost < best_move.cost) best_move=n;
+                }
+            }
+            if(best_move.cost < current.cost) current=best_move;
+            else step/=2;
+        }
+    }catch(std::out_of_range &){
+        //c is at the border of the grids, kept as it is
+        mainContext.interpolate=false;
+        return;
+    }
+    mainContext.interpolate=false;
+    status.evaluations+=evaluations;
+    M3D_DEBUG("refinement: "<<c.cost.toDouble()<<" -> "<<current.cost.toDouble()<<" ("<<evaluations<<" evaluations)");
+    c=current;
+}
+
+void PlanningData::publishResult(Cell &best, const CachedResult *cached)
+{
+    if(snapshot) return;
+    setRobots(r,h,&best);
+    std::map<std::string,double> details;
+    std::vector<std::map<std::string,double> > alternatives_details;
+    if(cached){
+        details=cached->details;
+        alternatives_details=cached->alternatives_details;
+    }else{
+        //the same evaluation as the one giving their cost (refineCell() leaves the cells it cannot interpolate as they are)
+        auto trace=[&](const Cell &c){
+            if(status.refined){
+                try{
+                    return traceCost(c,true).toMap(targets);
+                }catch(std::out_of_range &){
+                }
+            }
+            return traceCost(c).toMap(targets);
+        };
+        details=trace(best);
+        for(const Cell &a : alternatives){
+            alternatives_details.push_back(trace(a));
+        }
+        //only the complete searches are kept, a stopped one may be improved by the next run
+        if(resultKey && status.completed && best.cost.isValid()){
+            storeCachedResult(resultKey,CachedResult{best,alternatives,status,details,alternatives_details},resultCacheSize,
+                              sceneRevision,precomputed.gridRevision);
+        }
+    }
+    global_costSpace->setCostDetails(std::map<std::string,double>(details));
+
+    std::vector<std::string> visible_landmarks;
+    API::Parameter::lock_t lock;
+    if(targets.size()>1){
+        //check other visible targets
+        auto visib=getVisibilites(h,best.vPosHuman());
+        API::Parameter &otherVisParam = API::Parameter::root(lock)["PointingPlanner"]["result"]["other_visible"];
+        otherVisParam=API::Parameter(API::Parameter::ArrayValue);
+        for(uint i=0;i<visib.size();++i){
+            if(i!=best.target && visib[i]<vis_threshold){
+                visible_landmarks.push_back(targets[i]->getName());
+                otherVisParam.append(targets[i]->getName());
+                M3D_DEBUG("other visible landmark: "<< targets[i]->getName());
+            }
+        }
+    }
+    API::Parameter &targetParam = API::Parameter::root(lock)["PointingPlanner"]["result"]["target"];
+    targetParam=API::Parameter(API::Parameter::ArrayValue);
+    targetParam.append(targets[best.target]->getName());
+
+    API::Parameter &alternativesParam = API::Parameter::root(lock)["PointingPlanner"]["result"]["alternatives"];
+    alternativesParam=API::Parameter(API::Parameter::ArrayValue);
+    for(uint i=0;i<alternatives.size();++i){
+        Cell &a=alternatives[i];
+        API::Parameter alternative;
+        alternative["target"]=API::Parameter(targets[a.target]->getName());
+        alternative["robot"]=API::Parameter(std::vector<API::Parameter>{double(a.pos[0]),double(a.pos[1])});
+        alternative["human"]=API::Parameter(std::vector<API::Parameter>{double(a.pos[2]),double(a.pos[3])});
+        alternative["cost"]=API::Parameter(a.cost.toDouble());
+        API::Parameter &details=alternative["details"];
+        for(auto &d : alternatives_details[i]){
+            details[d.first]=API::Parameter(d.second);
+        }
+        alternativesParam.append(alternative);
+    }
+
+    API::Parameter &statusParam = API::Parameter::root(lock)["PointingPlanner"]["result"]["status"];
+    statusParam=API::Parameter();
+    statusParam["completed"]=API::Parameter(status.completed);
+    statusParam["deadline_reached"]=API::Parameter(status.deadline_reached);
+    statusParam["cancelled"]=API::Parameter(status.cancelled);
+    statusParam["expansions"]=API::Parameter(int(status.expansions));
+    statusParam["evaluations"]=API::Parameter(int(status.evaluations));
+    statusParam["elapsed"]=API::Parameter(status.elapsed);
+    statusParam["refined"]=API::Parameter(status.refined);
+    if(status.gap>=0.f)
+        statusParam["gap"]=API::Parameter(double(status.gap));
+    if(resultCacheSize){
+        statusParam["cached"]=API::Parameter(status.cached);
+        ResultCacheStats stats=resultCacheStats();
+        API::Parameter &cacheParam = API::Parameter::root(lock)["PointingPlanner"]["result"]["cache"];
+        cacheParam=API::Parameter();
+        cacheParam["hits"]=API::Parameter(int(stats.hits));
+        cacheParam["misses"]=API::Parameter(int(stats.misses));
+        cacheParam["hit_rate"]=API::Parameter(stats.hits+stats.misses ? double(stats.hits)/(stats.hits+stats.misses) : 0.);
+        cacheParam["size"]=API::Parameter(int(stats.size));
+    }
+}
+
+PlanningData::SceneSnapshot PlanningData::takeSnapshot() const
+{
+    SceneSnapshot snap;
+    snap.start_r=*r->getInitialPosition();
+    snap.start_h=*h->getInitialPosition();
+    snap.current_r=*r->getCurrentPos();
+    snap.current_h=*h->getCurrentPos();
+    snap.perspective_r=r->getHriAgent()->perspective->getVectorPos();
+    snap.perspective_h=h->getHriAgent()->perspective->getVectorPos();
+    for(Robot *t : targets){
+        snap.targetPos.push_back(t->getJoint(0)->getVectorPos());
+        snap.targetPos2d.push_back(m3dGeometry::getConfBase2DPos(*t->getCurrentPos()));
+    }
+    snap.staticObstacles=staticObstaclesHash();
+    snap.movableObstacles=movableObstaclesHash();
+    return snap;
+}
+
+std::vector<PlanningData::Cell> PlanningData::runConcurrently(const std::vector<PlanningData *> &plans, bool read_parameters)
+{
+    //all the reads of the shared scene are done here, before the threads start
+    std::vector<std::shared_ptr<const SceneSnapshot> > previous;
+    for(PlanningData *plan : plans){
+        if(read_parameters) plan->getParameters();
+        previous.push_back(plan->snapshot);
+        if(!plan->snapshot) plan->snapshot=std::make_shared<SceneSnapshot>(plan->takeSnapshot());
+    }
+    std::vector<std::future<Cell> > runs;
+    for(PlanningData *plan : plans){
+        runs.push_back(std::async(std::launch::async,[plan](){return plan->run(false);}));
+    }
+    for(std::future<Cell> &run : runs){
+        run.wait();
+    }
+    for(size_t i=0;i<plans.size();++i){
+        plans[i]->snapshot=previous[i];
+    }
+    std::vector<Cell> results;
+    for(std::future<Cell> &run : runs){
+        results.push_back(run.get());
+    }
+    return results;
+}
+
+std::vector<PlanningData::Cell *> PlanningData::searchPass(LatticeSearch &search, const SearchPass &pass)
+{
+    Grid &grid=*search.grid;
+    Cell *&best=search.best;
+    std::vector<Cell*> top; // best cells of this pass, sorted
+    auto add_candidate=[&](Cell *c){
+        auto it=std::upper_bound(top.begin(),top.end(),c,[](const Cell *a,const Cell *b){return a->cost < b->cost;});
+        if(size_t(it-top.begin())<pass.candidates){
+            top.insert(it,c);
+            if(top.size()>pass.candidates) top.pop_back();
+        }
+    };
+    auto in_windows=[&](const Grid::ArrayCoord &coord){
+        if(pass.windows.empty()) return true;
+        for(const Grid::ArrayCoord &w : pass.windows){
+            bool in=true;
+            for(uint d=0;d<4 && in;++d){
+                in = std::abs(long(coord[d])-long(w[d])) <= long(pass.radius);
+            }
+            if(in) return true;
+        }
+        return false;
+    };
+
+    //cells visited by a previous pass may be visited again
+    if(search.passes++){
+        for(Cell *c : search.created) c->open=false;
+    }
+    std::vector<Cell*> open_heap;
+    for(Cell *seed : pass.seeds){
+        seed->open=true;
+        open_heap.push_back(seed);
+        add_candidate(seed);
+        addAlternative(search,seed);
+    }
+
+    const std::vector<Move> &moves=moveOffsets(grid,search.start->coord);
+    Grid::ArrayCoord coord;
+    Cell *c;
+    bool found_best = false;
+
+    while(search.count<160000 && open_heap.size()){
         //std::pop_heap(open_heap.begin(),open_heap.end(),comp);
         coord = open_heap.back()->coord;
         open_heap.pop_back();
 
-        for (i=0;i<neighbours_number;++i)
+        search.expansion.clear();
+        search.to_evaluate.clear();
+        search.to_evaluate_pairs.clear();
+        for (const Move &move : moves)
         {
-            Grid::ArrayCoord neigh=grid.getNeighbour(coord,i);
+            //wraps out of the grid if negative
+            Grid::ArrayCoord neigh;
+            for(uint d=0;d<4;++d)
+                neigh[d] = coord[d] + pass.stride*move[d];
             try
             {
+                if(!in_windows(neigh))
+                    continue;
                 bool compute_cost=false;
                 c=grid[neigh];
                 if(!c)
@@ -111,47 +988,22 @@ PlanningData::Cell PlanningData::run(bool read_parameters)
                     grid[neigh]=c;
                     c->cost.constraint(MyConstraints::COL)=std::numeric_limits<float>::infinity();
                     compute_cost=true;
+                    search.created.push_back(c);
                 }
 
                 if(!c->open)
                 {
-                  if(isTooFar(c,start))
+                  if(isTooFar(c,search.start) || !inRegions(c))
                     c->open=true; //do not enter in the "if" bellow, hence ignores its neighbours
-
-                  if(!c->open)
+                  else if(compute_cost)
                   {
-                    if(compute_cost)
-                        computeCost(c);
-
-                    if(c->col > best->col)
-                        c->open=true; //skip also if in collision (and we were not)
-                    else
-                    {
-                      if(!found_best)
-                      {
-                        open_heap.push_back(c);
-                        //std::push_heap(open_heap.begin(),open_heap.end(),comp); 
-                      }
-
-                      c->open=true;
-                      if(c->cost < best->cost)
-                      {
-                          //Cell::CostType xx=best->cost;
-                          if(best->cost.toDouble() < 1000)
-                            found_best = true;
-
-                          best = c;
-                          iter_of_best=count;
-                          //setRobots(r,h,best);
-                          std::cout << "best: " << best->cost.toDouble() << " : " << best->cost.cost(MyCosts::COST) << std::endl;
-                          if(found_best)
-                          {
-                            open_heap.clear();
-                            open_heap.push_back(c);
-                          }
-                      }
-                    }
+                    prepareLatticeTerms(c);
+                    search.expansion.push_back(std::make_pair(c,int(search.to_evaluate.size())));
+                    search.to_evaluate.push_back(c);
+                    if(incremental) search.to_evaluate_pairs.push_back(&latticePairTerms(c));
                   }
+                  else
+                    search.expansion.push_back(std::make_pair(c,-1));
                 }
             }
             catch (Grid::out_of_grid &e)
@@ -159,55 +1011,218 @@ PlanningData::Cell PlanningData::run(bool read_parameters)
                 //that's normal, just keep on going.
             }
         }
-    }
-    //visibEngine->finish();
-    high_resolution_clock::time_point t2 = high_resolution_clock::now();
-    duration<double> time_span = duration_cast<duration<double>>(t2 - t1);
 
-    std::cout << "It took me " << time_span.count() << std::endl;
+        //the costs of the new cells do not depend on each other: evaluate them as a batch
+        std::vector<char> &evaluated=search.evaluated;
+        evaluated.assign(search.to_evaluate.size(),0);
+        search.pool->parallelFor(search.to_evaluate.size(),[&](size_t k,unsigned int worker){
+            try
+            {
+                Cell *cell=search.to_evaluate[k];
+                if(search.humanVisible && !(*search.humanVisible)[terms_h.index(cell,1)])
+                    transitCost(cell,(*search.contexts)[worker]);
+                else
+                    computeCostFactorized(cell,(*search.contexts)[worker],(incremental ? search.to_evaluate_pairs[k] : nullptr));
+                evaluated[k]=1;
+            }
+            catch (Grid::out_of_grid &e)
+            {
+                //that's normal, just keep on going.
+            }
+        });
+        status.evaluations+=search.to_evaluate.size();
+        if(search.humanVisible){
+            for(size_t k=0;k<search.to_evaluate.size();++k){
+                if(evaluated[k] && !(*search.humanVisible)[terms_h.index(search.to_evaluate[k],1)])
+                    search.transit.push_back(search.to_evaluate[k]);
+            }
+        }
 
-    setRobots(r,h,best);
-    M3D_DEBUG("done "<<best->cost.toDouble()<<" found at iteration #"<<iter_of_best
-              <<"\nit: "<<count<<" / "<<grid.getNumberOfCells()
-              <<"\ntarget: "<<targets[best->target]->getName()
-              <<"\n\tCcol="<<best->cost.constraint(MyConstraints::COL)
-              <<"\n\tCvis="<<best->cost.constraint(MyConstraints::VIS)
-              <<"\n\tcost="<<best->cost.cost(MyCosts::COST)
-              <<"\n\ttime="<<best->cost.cost(MyCosts::TIME)
-              );
-    {
-    std::vector<std::string> visible_landmarks;
-    API::Parameter::lock_t lock;
-    if(targets.size()>1){
-        //check other visible targets
-        auto visib=getVisibilites(h,best->vPosHuman());
-        API::Parameter &otherVisParam = API::Parameter::root(lock)["PointingPlanner"]["result"]["other_visible"];
-        otherVisParam=API::Parameter(API::Parameter::ArrayValue);
-        for(uint i=0;i<visib.size();++i){
-            if(i!=best->target && visib[i]<vis_threshold){
-                visible_landmarks.push_back(targets[i]->getName());
-                otherVisParam.append(targets[i]->getName());
-                M3D_DEBUG("other visible landmark: "<< targets[i]->getName());
+        //merge in the neighbour order, so that the result does not depend on the number of threads
+        for(const std::pair<Cell*,int> &n : search.expansion)
+        {
+            c=n.first;
+            if(n.second>=0 && !evaluated[n.second])
+                continue;
+
+            if(c->col > best->col)
+                c->open=true; //skip also if in collision (and we were not)
+            else
+            {
+              if(!found_best)
+              {
+                open_heap.push_back(c);
+                //std::push_heap(open_heap.begin(),open_heap.end(),comp); 
+              }
+
+              c->open=true;
+              add_candidate(c);
+              addAlternative(search,c);
+              if(c->cost < best->cost)
+              {
+                  //Cell::CostType xx=best->cost;
+                  if(best->cost.toDouble() < 1000)
+                    found_best = true;
+
+                  best = c;
+                  search.iter_of_best=search.count;
+                  //setRobots(r,h,best);
+                  std::cout << "best: " << best->cost.toDouble() << " : " << best->cost.cost(MyCosts::COST) << std::endl;
+                  if(found_best)
+                  {
+                    open_heap.clear();
+                    open_heap.push_back(c);
+                  }
+              }
             }
         }
+        ++search.count;
+
+        //checked after the expansion, so that at least the neighbours of the seeds are evaluated
+        if(deadline>0.f && std::chrono::steady_clock::now() >= search.deadline_time){
+            status.deadline_reached=true;
+            search.stopped=true;
+            break;
+        }
+        if(cancelled && cancelled()){
+            status.cancelled=true;
+            search.stopped=true;
+            break;
+        }
+        if(progress && progressPeriod && search.count%progressPeriod==0){
+            progress(Progress{search.count,float(best->cost.toDouble())});
+        }
     }
-    API::Parameter &targetParam = API::Parameter::root(lock)["PointingPlanner"]["result"]["target"];
-    targetParam=API::Parameter(API::Parameter::ArrayValue);
-    targetParam.append(targets[best->target]->getName());
+    if(found_best || !open_heap.empty()){
+        search.exhaustive=false;
     }
+    return top;
+}
 
-    Cell best_copy=*best;
-    for(uint i=0;i<grid.getNumberOfCells();++i){
-        if(grid.getCell(i)) delete grid.getCell(i);
-    }\
-    ENV.setBool(Env::isRunning,false);
-    M3D_DEBUG("PointingPlanner::run end");
-    if(!best_copy.cost.isValid()){
-        M3D_INFO("PointingPlanner::run invalid solution");
-        throw best_copy.cost.toDouble();
+const std::vector<PlanningData::Move> &PlanningData::moveOffsets(const Grid &grid, const Grid::ArrayCoord &coord)
+{
+    if(moves.empty() || movesBuiltFor!=moveSet){
+        moves.clear();
+        movesBuiltFor=moveSet;
+        for(unsigned int i=0;i<grid.neighboursNumber();++i){
+            Grid::ArrayCoord neigh=grid.getNeighbour(coord,i);
+            Move move;
+            uint axes=0;
+            for(uint d=0;d<4;++d){
+                move[d]=long(neigh[d])-long(coord[d]);
+                axes+=(move[d]!=0);
+            }
+            bool robot_moves=move[0] || move[1], human_moves=move[2] || move[3];
+            bool keep;
+            switch(moveSet){
+            case MoveSet::SINGLE_AGENT:
+                keep = !(robot_moves && human_moves);
+                break;
+            case MoveSet::AXIS:
+                keep = axes==1;
+                break;
+            case MoveSet::PRUNED:
+                //the diagonals over 3 or 4 axes are reached by two shorter moves
+                keep = axes<=2;
+                break;
+            default:
+                keep=true;
+            }
+            if(keep) moves.push_back(move);
+        }
     }
+    return moves;
+}
 
-    return best_copy;
+PlanningData::MoveSet PlanningData::moveSetFromName(const std::string &name)
+{
+    if(name=="single_agent") return MoveSet::SINGLE_AGENT;
+    if(name=="axis") return MoveSet::AXIS;
+    if(name=="pruned") return MoveSet::PRUNED;
+    if(name!="full") M3D_ERROR("unknown move set "<<name<<", using full");
+    return MoveSet::FULL;
+}
+
+PlanningData::Engine PlanningData::engineFromName(const std::string &name)
+{
+    if(name=="sampling") return Engine::SAMPLING;
+    if(name!="lattice") M3D_ERROR("unknown search engine "<<name<<", using lattice");
+    return Engine::LATTICE;
+}
+
+std::string PlanningData::moveSetName(MoveSet set)
+{
+    switch(set){
+    case MoveSet::SINGLE_AGENT: return "single_agent";
+    case MoveSet::AXIS: return "axis";
+    case MoveSet::PRUNED: return "pruned";
+    default: return "full";
+    }
+}
+
+void PlanningData::benchmarkMoveSets()
+{
+    getParameters();
+    MoveSet configured=moveSet;
+    //the full one last, so that the agents end at its solution
+    std::vector<MoveSet> sets{MoveSet::AXIS,MoveSet::SINGLE_AGENT,MoveSet::PRUNED,MoveSet::FULL};
+    std::vector<std::pair<float,RunStatus> > results;
+    for(MoveSet set : sets){
+        moveSet=set;
+        float cost=std::numeric_limits<float>::infinity();
+        try{
+            cost=run(false).cost.toDouble();
+        }catch(double &){
+            //invalid solution
+        }
+        results.push_back(std::make_pair(cost,status));
+        M3D_INFO("move set "<<moveSetName(set)<<": cost "<<cost<<", "<<status.expansions<<" expansions, "
+                 <<status.evaluations<<" evaluations, "<<status.elapsed<<"s");
+    }
+    moveSet=configured;
+
+    API::Parameter::lock_t lock;
+    API::Parameter &benchParam = API::Parameter::root(lock)["PointingPlanner"]["benchmark"]["move_sets"];
+    benchParam=API::Parameter(API::Parameter::ArrayValue);
+    for(uint i=0;i<sets.size();++i){
+        API::Parameter res;
+        res["move_set"]=API::Parameter(moveSetName(sets[i]));
+        //no cost for the runs that found no valid solution
+        bool valid=std::isfinite(results[i].first);
+        res["valid"]=API::Parameter(valid);
+        if(valid){
+            res["cost"]=API::Parameter(double(results[i].first));
+            //relative to the full neighbourhood, when it has one too
+            if(std::isfinite(results.back().first))
+                res["cost_ratio"]=API::Parameter(double(results[i].first/results.back().first));
+        }
+        res["expansions"]=API::Parameter(int(results[i].second.expansions));
+        res["evaluations"]=API::Parameter(int(results[i].second.evaluations));
+        res["elapsed"]=API::Parameter(results[i].second.elapsed);
+        benchParam.append(res);
+    }
+}
+
+void PlanningData::addAlternative(LatticeSearch &search, Cell *c)
+{
+    std::vector<Cell*> &alt=search.alternatives;
+    //only the solutions: neither the transit cells nor the ones violating a constraint
+    if(!alternativesCount || !c->cost.isValid())
+        return;
+    if(std::find(alt.begin(),alt.end(),c)!=alt.end())
+        return;
+    const float sep2=alternativesSeparation*alternativesSeparation;
+    auto close=[&](const Cell *a){
+        return a->target==c->target
+                && (a->vPosRobot()-c->vPosRobot()).squaredNorm() < sep2
+                && (a->vPosHuman()-c->vPosHuman()).squaredNorm() < sep2;
+    };
+    auto it=std::upper_bound(alt.begin(),alt.end(),c,[](const Cell *a,const Cell *b){return a->cost < b->cost;});
+    if(size_t(it-alt.begin())>=alternativesCount || std::any_of(alt.begin(),it,close))
+        return;
+    it=alt.insert(it,c)+1;
+    alt.erase(std::remove_if(it,alt.end(),close),alt.end());
+    if(alt.size()>alternativesCount) alt.pop_back();
 }
 
 PlanningData::Cell *PlanningData::createCell(Grid::ArrayCoord coord, Grid::SpaceCoord pos){
@@ -233,95 +1248,568 @@ void PlanningData::setRobots(Robot *a, Robot *b, Cell *cell){
     moveRobotToHalfAngle(cell,cell->target);
 }
 
-PlanningData::Cost PlanningData::targetCost(Cell *c, uint i, float visib,float visib_r)
+PlanningData::Cost PlanningData::targetCost(Cell *c, uint i, float visib,float visib_r)
+{
+    c->target = i;
+    return targetCost(c,i,visib,visib_r,mainContext);
+}
+
+PlanningData::Cost PlanningData::targetCost(const Cell *c, uint i, float visib, float visib_r, EvalContext &ctx)
+{
+    visib = std::max(visib,visib_r);
+    visib = std::max(0.f,visib);
+    Cost cost;
+    float kh(1-mh), kr(1-mr);
+    float c_visib = bounded_affine<float>(visib,0.2f,vis_threshold,0.f,1.f);
+    c_visib*=c_visib;
+    Eigen::Vector3d rt,ht,hr;
+    Eigen::Vector2d rt2,ht2,hr2;
+    //perspectives of the agents placed as setRobots() would do (human facing the target, robot at half angle)
+    Eigen::Vector2d pr(c->vPosRobot()),ph(c->vPosHuman());
+    float yaw_h = m3dGeometry::angle(targetPos2d[i]-ph);
+    float yaw_r = m3dGeometry::angle(ph-pr) + m3dGeometry::angle(targetPos2d[i]-pr,ph-pr)/2;
+    Eigen::Vector3d persp_r = perspectivePos(pre->perspectiveOffset_r,pr,yaw_r);
+    Eigen::Vector3d persp_h = perspectivePos(pre->perspectiveOffset_h,ph,yaw_h);
+    rt =  targetPos[i] - persp_r;
+    ht =  targetPos[i] - persp_h;
+    hr = persp_r - persp_h;
+    for(uint i=0;i<2;++i){
+        rt2[i]=rt[i];
+        ht2[i]=ht[i];
+        hr2[i]=hr[i];
+    }
+    rt2.normalize();
+    ht2.normalize();
+    hr2.normalize();
+
+    float angle_h = std::acos(hr2.dot(ht2));//angle for the human to look at the target and the robot
+    float angle_r = std::acos((-hr2).dot(rt2));//idem for robot -> human
+    //visib = std::max(0.f,(1-visibility(i,ph))); //visibility cost (i.e. 1=worst, 0=best) of the target for the human
+    float angle_persp = std::acos((ht2).dot(rt2)); // perspective difference weighted by the visibility of the target
+
+    float c_angle_r,c_angle_h,c_angle_persp, c_route_dir;
+    c_angle_h = bounded_affine<float>(angle_h,0.,float(M_PI));
+    c_angle_r = bounded_affine<float>(angle_r,0,float(M_PI));
+    c_angle_persp = bounded_affine<float>(angle_persp,0,float(M_PI)); //perspective difference
+
+    c_route_dir=getRouteDirTime(c,i);
+
+    cost.constraint(MyConstraints::COL)=0.f;
+    cost.constraint(MyConstraints::VIS) = std::max<float>(0.,visib - vis_threshold);
+    cost.constraint(MyConstraints::ANGLE) = std::max<float>(0., std::pow(angle_h - desired_angle_h,2.) - desired_angle_h_tolerance*desired_angle_h_tolerance);
+    cost.cost(MyCosts::COST) = c_angle_r * kr + c_angle_h * kh + c_angle_persp * ka;
+    cost.cost(MyCosts::TIME) = c_route_dir;
+    cost.cost(MyCosts::VISIB) = c_visib;
+
+    if(ctx.trace){
+        CostTrace::Target &details = ctx.trace->targets.at(i);
+        details.angle_h =     180./M_PI * angle_h;
+        details.angle_r =     180./M_PI * angle_r;
+        details.angle_persp = 180./M_PI * angle_persp;
+        details.visib =       visib;
+        details.cost =        cost.cost(MyCosts::COST);
+    }
+
+    return cost;
+
+}
+
+float PlanningData::getRouteDirTime(const PlanningData::Cell *, uint i)
+{
+    if(routeDirTimes.size()==0){return 0.f;}
+    return routeDirTimes.at(i);
+}
+
+PlanningData::Cost PlanningData::computeCost(Cell *c)
+{
+    CostTrace trace;
+    Cost cost;
+    mainContext.trace=&trace;
+    try{
+        cost=computeCost(c,mainContext);
+    }catch(...){
+        mainContext.trace=nullptr;
+        throw;
+    }
+    mainContext.trace=nullptr;
+    if(!snapshot) global_costSpace->setCostDetails(trace.toMap(targets));
+    return cost;
+}
+
+PlanningData::CostTrace PlanningData::traceCost(const Cell &c, bool interpolate)
+{
+    Cell copy(c);
+    CostTrace trace;
+    mainContext.trace=&trace;
+    mainContext.interpolate=interpolate;
+    try{
+        computeCost(&copy,mainContext);
+    }catch(...){
+        mainContext.trace=nullptr;
+        mainContext.interpolate=false;
+        throw;
+    }
+    mainContext.trace=nullptr;
+    mainContext.interpolate=false;
+    return trace;
+}
+
+std::map<std::string, double> PlanningData::CostTrace::toMap(const std::vector<Robot *> &target_robots) const
+{
+    std::map<std::string,double> costDetails;
+    for(uint i=0;i<targets.size() && i<target_robots.size();++i){
+        const std::string &name=target_robots[i]->getName();
+        costDetails[name+" angle h"]=     double(targets[i].angle_h);
+        costDetails[name+" angle r"]=     double(targets[i].angle_r);
+        costDetails[name+" angle persp"]= double(targets[i].angle_persp);
+        costDetails[name+" visib"]=       double(targets[i].visib);
+        costDetails[name+" cost"]=        double(targets[i].cost);
+    }
+    costDetails["0dist r"]=      double(dist_r);
+    costDetails["0dist h"]=      double(dist_h);
+    costDetails["1time human"]=  double(time_h);
+    costDetails["1time robot"]=  double(time_r);
+    costDetails["2proxemics"]=   double(proxemics);
+    costDetails["2time dir"] =   double(time_dir);
+    costDetails["2target cost"]= double(target_cost);
+    return costDetails;
+}
+
+PlanningData::Cost PlanningData::computeCost(Cell *c, EvalContext &ctx)
+{
+    AgentTerms terms_r,terms_h;
+    computeAgentTerms(0,c->vPosRobot(),terms_r,ctx.visib_rob,ctx.interpolate);
+    computeAgentTerms(1,c->vPosHuman(),terms_h,ctx.visib,ctx.interpolate);
+    return combineCost(c,terms_r,ctx.visib_rob.data(),terms_h,ctx.visib.data(),ctx);
+}
+
+PlanningData::Cost PlanningData::computeCostFactorized(Cell *c, EvalContext &ctx, PairTerms *pair)
+{
+    size_t ir=this->terms_r.index(c,0), ih=this->terms_h.index(c,1);
+    assert(this->terms_r.ready[ir] && this->terms_h.ready[ih]);
+    return combineCost(c,
+                       this->terms_r.terms[ir],this->terms_r.visib.data()+ir*targets.size(),
+                       this->terms_h.terms[ih],this->terms_h.visib.data()+ih*targets.size(),
+                       ctx,pair);
+}
+
+PlanningData::Cost PlanningData::transitCost(Cell *c, EvalContext &ctx)
+{
+    size_t ir=terms_r.index(c,0), ih=terms_h.index(c,1);
+    int col = 3 - int(terms_r.terms[ir].free) - int(terms_h.terms[ih].free) - int(agentsApart(c,ctx));
+    c->cost=Cell::CostType{};
+    c->cost.constraint(MyConstraints::COL)=col;
+    c->cost.constraint(MyConstraints::VIS)=std::numeric_limits<float>::infinity();
+    c->cost.cost(MyCosts::COST)=std::numeric_limits<float>::infinity();
+    c->col = (col!=0);
+    c->vis = false;
+    c->target = 0;
+    return c->cost;
+}
+
+bool PlanningData::restrictToRegions(std::vector<double> &envSize)
+{
+    std::shared_ptr<const RegionMap> map=pre->regionMap(doorwayWidth,threads);
+    const RegionMap &regions=*map;
+    const size_t nx=pre->nx, ny=pre->ny;
+    //as isTooFar()
+    const float reach_r=(mr>0.f ? std::min(max_dist,max_time_r*sr/2) : 0.f), reach_h=(mh>0.f ? max_dist : 0.f);
+    std::vector<char> reachable_r(nx*ny,0),reachable_h(nx*ny,0);
+    for(size_t i=0;i<pre->freespace_h.getNumberOfCells();++i){
+        API::nDimGrid<bool,2>::ArrayCoord c=pre->freespace_h.getCellCoord(i);
+        reachable_r[c[0]+nx*c[1]] = pre->distGrid_r.getGrid().getCell(i) <= reach_r;
+        reachable_h[c[0]+nx*c[1]] = pre->distGrid_h.getGrid().getCell(i) <= reach_h;
+    }
+
+    //the regions of the starts, and the ones where the human sees a mandatory target
+    std::vector<char> keep(regions.size(),0),sees_targets(regions.size(),0);
+    std::vector<int> start_regions;
+    bool any_target = anyTarget && indexFirstOptionalTarget>0;
+    for(uint agent=0;agent<2;++agent){
+        Eigen::Vector2d start=(agent==0 ? start_p_r : start_p_h);
+        try{
+            API::nDimGrid<bool,2>::ArrayCoord c=pre->freespace_h.getCellCoord(std::array<float,2>{{float(start[0]),float(start[1])}});
+            int region=regions.region(c[0]+nx*c[1]);
+            if(region>=0){
+                keep[region]=1;
+                start_regions.push_back(region);
+            }
+        }catch(API::nDimGrid<bool,2>::out_of_grid &){
+            return false;
+        }
+    }
+    std::vector<const std::vector<float>*> slices;
+    for(uint k=0;k<indexFirstOptionalTarget;++k){
+        slices.push_back(&pre->visibilitySlice(1,targets[k]));
+    }
+    for(size_t i=0;i<nx*ny;++i){
+        int region=regions.region(i);
+        if(region<0 || keep[region] || !reachable_h[i]) continue;
+        //without mandatory target, all the reachable regions are kept
+        bool sees = !any_target;
+        for(const std::vector<float> *slice : slices){
+            bool v=(*slice)[i]<=vis_threshold;
+            sees = (any_target ? sees || v : sees && v);
+        }
+        if(sees) sees_targets[region]=1;
+    }
+    //and the ones between: the search is a flood fill from the starts, through the regions where an agent can go
+    std::vector<char> passable(regions.size(),0);
+    for(size_t i=0;i<nx*ny;++i){
+        int region=regions.region(i);
+        if(region>=0 && (reachable_r[i] || reachable_h[i])) passable[region]=1;
+    }
+    std::vector<int> previous(regions.size(),-2); //-2: not reached, -1: start region
+    std::deque<int> queue;
+    for(int region : start_regions){
+        if(previous[region]!=-2) continue;
+        previous[region]=-1;
+        queue.push_back(region);
+    }
+    while(!queue.empty()){
+        int region=queue.front();
+        queue.pop_front();
+        for(int n : regions.adjacent(region)){
+            if(previous[n]!=-2 || !passable[n]) continue;
+            previous[n]=region;
+            queue.push_back(n);
+        }
+    }
+    for(size_t region=0;region<regions.size();++region){
+        if(!sees_targets[region]) continue;
+        //the path of fewest regions from a start
+        for(int k=region;k>=0 && !keep[k];k=previous[k]) keep[k]=1;
+    }
+    //the robot may stand in a neighbour region (e.g. a doorway)
+    std::vector<char> seen=keep;
+    for(size_t region=0;region<regions.size();++region){
+        if(!seen[region]) continue;
+        for(int n : regions.adjacent(region)) keep[n]=1;
+    }
+
+    //bounding boxes of the cells kept for each agent, with a margin of one cell
+    regionCells_r.assign(nx*ny,0);
+    regionCells_h.assign(nx*ny,0);
+    size_t kept=0,kept_regions=std::count(keep.begin(),keep.end(),1);
+    long box[2][4]={{long(nx),long(ny),-1,-1},{long(nx),long(ny),-1,-1}}; //xmin,ymin,xmax,ymax
+    for(long y=0;y<long(ny);++y){
+        for(long x=0;x<long(nx);++x){
+            size_t i=x+nx*y;
+            int region=regions.region(i);
+            //the cells blocked for the human may be free for the robot
+            regionCells_r[i] = reachable_r[i] && (region<0 || keep[region]);
+            regionCells_h[i] = reachable_h[i] && region>=0 && keep[region];
+            for(uint agent=0;agent<2;++agent){
+                if(!(agent==0 ? regionCells_r : regionCells_h)[i]) continue;
+                long *b=box[agent];
+                b[0]=std::min(b[0],x); b[1]=std::min(b[1],y);
+                b[2]=std::max(b[2],x); b[3]=std::max(b[3],y);
+            }
+            kept+=regionCells_h[i];
+        }
+    }
+    if(box[0][2]<0 || box[1][2]<0){
+        regionCells_r.clear();
+        regionCells_h.clear();
+        return false;
+    }
+    API::nDimGrid<bool,2>::SpaceCoord size=pre->freespace_h.getCellSize();
+    API::nDimGrid<bool,2>::SpaceCoord first=pre->freespace_h.getCellCenter(API::nDimGrid<bool,2>::ArrayCoord{{0,0}});
+    for(uint agent=0;agent<2;++agent){
+        long *b=box[agent];
+        b[0]=std::max(0l,b[0]-1); b[1]=std::max(0l,b[1]-1);
+        b[2]=std::min(long(nx)-1,b[2]+1); b[3]=std::min(long(ny)-1,b[3]+1);
+        //the bounds are the borders of the kept cells (with a quarter of cell of slack): the lattice cells are the ones of the freespace grids
+        envSize[agent*4+0]=first[0]+(b[0]-0.5)*size[0];
+        envSize[agent*4+1]=first[0]+(b[2]+0.75)*size[0];
+        envSize[agent*4+2]=first[1]+(b[1]-0.5)*size[1];
+        envSize[agent*4+3]=first[1]+(b[3]+0.75)*size[1];
+    }
+    M3D_DEBUG("region pruning: "<<kept_regions<<" / "<<regions.size()<<" regions kept, "<<kept<<" human cells, lattice of "
+              <<(box[0][2]-box[0][0]+1)<<"x"<<(box[0][3]-box[0][1]+1)<<" robot cells and "
+              <<(box[1][2]-box[1][0]+1)<<"x"<<(box[1][3]-box[1][1]+1)<<" human cells");
+    return true;
+}
+
+bool PlanningData::computeLatticeOffset(const Grid &grid)
+{
+    latticeOffset=Grid::ArrayCoord{{0,0,0,0}};
+    Grid::ArrayCoord shape=grid.getCellCoord(grid.getNumberOfCells()-1);
+    Grid::SpaceCoord first=grid.getCellCenter(Grid::ArrayCoord{{0,0,0,0}});
+    Grid::SpaceCoord last=grid.getCellCenter(shape);
+    API::nDimGrid<bool,2>::SpaceCoord size=pre->freespace_h.getCellSize();
+    Grid::ArrayCoord offset;
+    for(uint agent=0;agent<2;++agent){
+        try{
+            API::nDimGrid<bool,2>::ArrayCoord a=pre->freespace_h.getCellCoord(std::array<float,2>{{first[agent*2],first[agent*2+1]}});
+            API::nDimGrid<bool,2>::ArrayCoord b=pre->freespace_h.getCellCoord(std::array<float,2>{{last[agent*2],last[agent*2+1]}});
+            API::nDimGrid<bool,2>::SpaceCoord center=pre->freespace_h.getCellCenter(a);
+            if(b[0]-a[0]!=shape[agent*2] || b[1]-a[1]!=shape[agent*2+1] ||
+                    std::abs(center[0]-first[agent*2])>size[0]/4 || std::abs(center[1]-first[agent*2+1])>size[1]/4){
+                return false;
+            }
+            offset[agent*2]=a[0];
+            offset[agent*2+1]=a[1];
+        }catch(API::nDimGrid<bool,2>::out_of_grid &){
+            return false;
+        }
+    }
+    latticeOffset=offset;
+    return true;
+}
+
+bool PlanningData::inRegions(const Cell *c) const
+{
+    if(regionCells_h.empty()) return true;
+    size_t nx=pre->nx;
+    return regionCells_r[c->coord[0]+latticeOffset[0] + nx*(c->coord[1]+latticeOffset[1])] &&
+            regionCells_h[c->coord[2]+latticeOffset[2] + nx*(c->coord[3]+latticeOffset[3])];
+}
+
+bool PlanningData::computeHumanVisibleCells(const Grid &grid, const Cell *start, std::vector<char> &visible)
+{
+    Grid::ArrayCoord shape=grid.getCellCoord(grid.getNumberOfCells()-1);
+    size_t nx=shape[2]+1, ny=shape[3]+1;
+    bool any_target = anyTarget && indexFirstOptionalTarget>0;
+    //in any target mode, seeing one of the mandatory targets is enough
+    visible.assign(nx*ny,any_target ? 0 : 1);
+    for(uint k=0;k<indexFirstOptionalTarget;++k){
+        const std::vector<float> &slice=pre->visibilitySlice(1,targets[k]);
+        for(size_t y=0;y<ny;++y){
+            for(size_t x=0;x<nx;++x){
+                size_t i=x+nx*y;
+                float v=slice[x+latticeOffset[2] + pre->nx*(y+latticeOffset[3])];
+                if(any_target && v<=vis_threshold) visible[i]=1;
+                else if(!any_target && v>vis_threshold) visible[i]=0;
+            }
+        }
+    }
+    //the search does not go farther (see isTooFar)
+    Eigen::Vector2d from=start->vPosHuman();
+    size_t reachable=0,n_visible=0;
+    for(size_t y=0;y<ny;++y){
+        for(size_t x=0;x<nx;++x){
+            Grid::ArrayCoord coord{{0,0,x,y}};
+            Grid::SpaceCoord c=grid.getCellCenter(coord);
+            if((Eigen::Vector2d(c[2],c[3])-from).norm() > max_dist) continue;
+            ++reachable;
+            n_visible += visible[x+nx*y];
+        }
+    }
+    M3D_DEBUG("visibility pruning: "<<n_visible<<" / "<<reachable<<" human cells see all the mandatory targets");
+    return n_visible>0;
+}
+
+PlanningData::PairTerms &PlanningData::latticePairTerms(const Cell *c)
+{
+    size_t nxy_r=terms_r.terms.size();
+    return pairTerms[terms_r.index(c,0)+nxy_r*terms_h.index(c,1)];
+}
+
+PlanningData::LatticeTermsKey PlanningData::latticeTermsKey(const Grid &grid) const
+{
+    LatticeTermsKey key;
+    key.scene=precomputed;
+    key.shape=grid.getCellCoord(grid.getNumberOfCells()-1);
+    key.offset=latticeOffset;
+    key.targets=targets;
+    key.indexFirstOptionalTarget=indexFirstOptionalTarget;
+    key.targetPos=targetPos;
+    key.routeDirTimes=routeDirTimes;
+    key.params={mr,mh,ka,vis_threshold,desired_angle_h,desired_angle_h_tolerance,float(anyTarget)};
+    return key;
+}
+
+bool PlanningData::LatticeTermsKey::operator==(const LatticeTermsKey &other) const
+{
+    return scene.sameScene(other.scene) && shape==other.shape && offset==other.offset &&
+            targets==other.targets && indexFirstOptionalTarget==other.indexFirstOptionalTarget &&
+            targetPos==other.targetPos && routeDirTimes==other.routeDirTimes && params==other.params;
+}
+
+void PlanningData::computeAgentTerms(uint agent, const Eigen::Vector2d &pos2d, AgentTerms &terms, std::vector<float> &visib, bool interpolate)
+{
+    std::array<float,2> p{{float(pos2d[0]),float(pos2d[1])}};
+    const API::nDimGrid<bool,2> &freespace = (agent==0 ? pre->freespace_r : pre->freespace_h);
+    terms.free=freespace.getCell(p);
+    if(!interpolate){
+        getVisibilites(Eigen::Vector3d(pos2d[0],pos2d[1],(agent==0 ? pre->perspectiveOffset_r : pre->perspectiveOffset_h)[2]),visib);
+        computeDistTerms(agent,pos2d,terms);
+        return;
+    }
+    //from the values at the centers of the surrounding cells
+    size_t nx=pre->nx;
+    visib.resize(targets.size());
+    for(uint i=0;i<targets.size();++i){
+        const std::vector<float> &slice=pre->visibilitySlice(agent,targets[i]);
+        visib[i]=bilinear(freespace,pos2d,[&](long x,long y){return slice[x+nx*y];});
+    }
+    auto field=[&](const DistanceField2d &d){
+        const API::nDimGrid<float,2> &g=d.getGrid();
+        return bilinear(g,pos2d,[&](long x,long y){
+            API::nDimGrid<float,2>::ArrayCoord xy;
+            xy[0]=x;
+            xy[1]=y;
+            return g.getCell(xy);
+        });
+    };
+    if(agent==0){
+        terms.dist=field(pre->distGrid_r);
+        terms.dist_target=0.f;
+    }else{
+        terms.dist=field(pre->distGrid_h);
+        terms.dist_target = (usePhysicalTarget ? field(pre->distGrid_physicalTarget) : 0.f);
+    }
+}
+
+void PlanningData::computeDistTerms(uint agent, const Eigen::Vector2d &pos2d, AgentTerms &terms)
 {
-    visib = std::max(visib,visib_r);
-    visib = std::max(0.f,visib);
-    Cost cost;
-    float kh(1-mh), kr(1-mr);
-    float c_visib = bounded_affine<float>(visib,0.2f,vis_threshold,0.f,1.f);
-    c_visib*=c_visib;
-    Eigen::Vector3d rt,ht,hr;
-    Eigen::Vector2d rt2,ht2,hr2;
-    Robot *target=targets[i];
-    c->target = i; //used by setRobots
-    this->setRobots(r,h,c);
-    rt =  target->getJoint(0)->getVectorPos() - r->getHriAgent()->perspective->getVectorPos();
-    ht =  target->getJoint(0)->getVectorPos() - h->getHriAgent()->perspective->getVectorPos();
-    hr = r->getHriAgent()->perspective->getVectorPos() - h->getHriAgent()->perspective->getVectorPos();
-    for(uint i=0;i<2;++i){
-        rt2[i]=rt[i];
-        ht2[i]=ht[i];
-        hr2[i]=hr[i];
+    std::array<float,2> p{{float(pos2d[0]),float(pos2d[1])}};
+    if(agent==0){
+        terms.dist=pre->distGrid_r.getCostPos(p);
+        terms.dist_target=0.f;
+    }else{
+        terms.dist=pre->distGrid_h.getCostPos(p);
+        terms.dist_target = (usePhysicalTarget ? pre->distGrid_physicalTarget.getCostPos(p) : 0.f);
     }
-    rt2.normalize();
-    ht2.normalize();
-    hr2.normalize();
-
-    float angle_h = std::acos(hr2.dot(ht2));//angle for the human to look at the target and the robot
-    float angle_r = std::acos((-hr2).dot(rt2));//idem for robot -> human
-    //visib = std::max(0.f,(1-visibility(i,ph))); //visibility cost (i.e. 1=worst, 0=best) of the target for the human
-    float angle_persp = std::acos((ht2).dot(rt2)); // perspective difference weighted by the visibility of the target
+}
 
-    float c_angle_r,c_angle_h,c_angle_persp, c_route_dir;
-    c_angle_h = bounded_affine<float>(angle_h,0.,float(M_PI));
-    c_angle_r = bounded_affine<float>(angle_r,0,float(M_PI));
-    c_angle_persp = bounded_affine<float>(angle_persp,0,float(M_PI)); //perspective difference
+std::shared_ptr<const RegionMap> PlanningData::Precomputation::regionMap(float doorway_width, unsigned int threads)
+{
+    std::lock_guard<std::mutex> lock(regions->mutex);
+    std::shared_ptr<const RegionMap> &map=regions->maps[doorway_width];
+    if(!map){
+        WorkerPool pool(threads);
+        map=std::make_shared<RegionMap>(freespace_h,doorway_width,pool);
+    }
+    return map;
+}
 
-    c_route_dir=getRouteDirTime(c,i);
+const std::vector<float> &PlanningData::Precomputation::visibilitySlice(uint agent, Robot *target)
+{
+    std::lock_guard<std::mutex> lock(slices->mutex);
+    std::vector<float> &slice=slices->slices[std::make_pair(agent,target)];
+    if(slice.empty()){
+        const API::nDimGrid<bool,2> &grid = (agent==0 ? freespace_r : freespace_h);
+        float z = (agent==0 ? perspectiveOffset_r : perspectiveOffset_h)[2];
+        slice.assign(nx*ny,1.f);
+        for(uint i=0;i<grid.getNumberOfCells();++i){
+            API::nDimGrid<bool,2>::ArrayCoord coord=grid.getCellCoord(i);
+            API::nDimGrid<bool,2>::SpaceCoord c=grid.getCellCenter(coord);
+            VisibilityGrid3d::SpaceCoord p{{c[0],c[1],z}};
+            try{
+                VisibilityGrid3d::reference cell=key.visibilityGrid->getCell(p);
+                auto it=cell.find(target);
+                slice[coord[0]+nx*coord[1]] = 1.f - (it==cell.end() ? 0.f : it->second);
+            }catch(VisibilityGrid3d::out_of_grid &){
+            }
+        }
+    }
+    return slice;
+}
 
-    cost.constraint(MyConstraints::COL)=0.f;
-    cost.constraint(MyConstraints::VIS) = std::max<float>(0.,visib - vis_threshold);
-    cost.constraint(MyConstraints::ANGLE) = std::max<float>(0., std::pow(angle_h - desired_angle_h,2.) - desired_angle_h_tolerance*desired_angle_h_tolerance);
-    cost.cost(MyCosts::COST) = c_angle_r * kr + c_angle_h * kh + c_angle_persp * ka;
-    cost.cost(MyCosts::TIME) = c_route_dir;
-    cost.cost(MyCosts::VISIB) = c_visib;
+void PlanningData::AgentTermsTable::reset(size_t nx, size_t ny, size_t ntargets)
+{
+    this->nx=nx;
+    this->ntargets=ntargets;
+    terms.assign(nx*ny,AgentTerms{});
+    visib.assign(nx*ny*ntargets,1.f);
+    ready.assign(nx*ny,0);
+    distVersion.assign(nx*ny,0);
+}
 
-    std::map<std::string,double> costDetails = global_costSpace->getCostDetails();
-    costDetails[target->getName()+" angle h"]=     double(180./M_PI * angle_h);
-    costDetails[target->getName()+" angle r"]=     double(180./M_PI * angle_r);
-    costDetails[target->getName()+" angle persp"]= double(180./M_PI * angle_persp);
-    costDetails[target->getName()+" visib"]=       double(visib);
-    costDetails[target->getName()+" cost"]=       double(cost.cost(MyCosts::COST));
-    global_costSpace->setCostDetails(std::move(costDetails));
+void PlanningData::resetLatticeTerms(const Grid &grid)
+{
+    //the last cell has the highest coordinate on every axis
+    Grid::ArrayCoord shape=grid.getCellCoord(grid.getNumberOfCells()-1);
+    terms_r.reset(shape[0]+1,shape[1]+1,targets.size());
+    terms_h.reset(shape[2]+1,shape[3]+1,targets.size());
+}
 
-    return cost;
+void PlanningData::prepareLatticeTerms(const Cell *c)
+{
+    for(uint agent=0;agent<2;++agent){
+        AgentTermsTable &table = (agent==0 ? terms_r : terms_h);
+        size_t i=table.index(c,agent);
+        if(!table.ready[i]){
+            computeAgentTerms(agent,c->getPos(agent),table.terms[i],mainContext.visib);
+            //the lattice cells are cells of the freespace grids (shifted by latticeOffset): use the shared visibility slices
+            size_t i_slice=c->coord[agent*2]+latticeOffset[agent*2] + pre->nx*(c->coord[agent*2+1]+latticeOffset[agent*2+1]);
+            for(uint k=0;k<table.ntargets;++k){
+                table.visib[i*table.ntargets+k] = pre->visibilitySlice(agent,targets[k])[i_slice];
+            }
+            table.ready[i]=1;
+            table.distVersion[i]=precomputationVersion;
+        }else if(table.distVersion[i]!=precomputationVersion){
+            //kept from a previous run, only the distances changed
+            computeDistTerms(agent,c->getPos(agent),table.terms[i]);
+            table.distVersion[i]=precomputationVersion;
+        }
+    }
+}
 
+bool PlanningData::agentsApart(const Cell *c, EvalContext &ctx)
+{
+    Eigen::Vector2d pr(c->vPosRobot()),ph(c->vPosHuman());
+    if(pre->agentsClearance>=0.f){
+        //both agents are vertical cylinders: only their distance matters
+        return (pr-ph).squaredNorm() >= double(pre->agentsClearance)*pre->agentsClearance;
+    }
+    //the checker moves the robots of the scene: one check at a time
+    std::lock_guard<std::mutex> lock(collisionMutex);
+    return ctx.collision->moveCheck(r,Eigen::Vector3d(pr[0],pr[1],0.),h,Eigen::Vector3d(ph[0],ph[1],0.));
 }
 
-float PlanningData::getRouteDirTime(PlanningData::Cell *, uint i)
+void PlanningData::calibrateAgentsClearance(Precomputation &pre)
 {
-    if(routeDirTimes.size()==0){return 0.f;}
-    return routeDirTimes.at(i);
+    const double max_clearance=3.; // more than the sum of the radii of any agent cylinders
+    const uint nb_directions=8;
+    API::CylinderCollision &coll=*mainContext.collision;
+    std::lock_guard<std::mutex> lock(collisionMutex);
+    Eigen::Vector3d pr(start_p_r[0],start_p_r[1],0.);
+    const API::nDimGrid<bool,2> &freespace_h=pre.freespace_h;
+    pre.agentsClearance=-1.f;
+    for(uint d=0;d<nb_directions;++d){
+        double a=2*M_PI*d/nb_directions;
+        Eigen::Vector3d u(std::cos(a),std::sin(a),0.);
+        //the human must be away from the environment all along the segment, so that only the robot can collide with it
+        bool free=true;
+        double step=std::min(freespace_h.getCellSize()[0],freespace_h.getCellSize()[1])/2.;
+        try{
+            for(double t=0.;t<=max_clearance && free;t+=step){
+                Eigen::Vector3d p=pr+t*u;
+                free = freespace_h.getCell(std::array<float,2>{{float(p[0]),float(p[1])}});
+            }
+        }catch(API::nDimGrid<bool,2>::out_of_grid &){
+            free=false;
+        }
+        if(!free || !coll.moveCheck(r,pr,h,pr+max_clearance*u)){
+            continue;
+        }
+        double lo=0.,hi=max_clearance;
+        for(uint i=0;i<20;++i){
+            double mid=(lo+hi)/2;
+            if(coll.moveCheck(r,pr,h,pr+mid*u)) hi=mid;
+            else lo=mid;
+        }
+        pre.agentsClearance=hi;
+        M3D_DEBUG("agents clearance = "<<pre.agentsClearance);
+        return;
+    }
+    M3D_INFO("could not measure the clearance between the agents, checking their collisions cell by cell");
 }
 
-PlanningData::Cost PlanningData::computeCost(Cell *c)
+PlanningData::Cost PlanningData::combineCost(Cell *c, const AgentTerms &terms_r, const float *visib_r, const AgentTerms &terms_h, const float *visib_h, EvalContext &ctx, PairTerms *pair)
 {
-    global_costSpace->setCostDetails(std::map<std::string,double>{});
+    if(ctx.trace) ctx.trace->targets.resize(targets.size());
     c->cost=Cell::CostType{};
     float kh(1-mh), kr(1-mr);
-    float cost;
-    std::vector<float> angle_h(targets.size());
-    std::vector<float> angle_r(targets.size());
-    std::vector<float> angle_persp(targets.size());
-    std::vector<float> visib(targets.size());
-    std::vector<float> visib_rob(targets.size());
-
-    Eigen::Vector3d hr = r->getHriAgent()->perspective->getVectorPos() - h->getHriAgent()->perspective->getVectorPos();
-    if(hr.squaredNorm()){
-        //if vector is non null
-        hr.normalize();
-    }
+
     Eigen::Vector2d pr,ph;
     pr=c->vPosRobot();
     ph=c->vPosHuman();
-    //move agents to positions of the cell: -> done in targetCost
-    //m3dGeometry::setBasePosition2D(r,pr);
-    //m3dGeometry::setBasePosition2D(h,ph);
+    //the agents are not moved, their perspectives are computed from the precomputed offsets
 
-    //for each target get its related values
-    visib = getVisibilites(h,c->vPosHuman());
-    visib_rob = getVisibilites(r,c->vPosRobot());
     Cost best_target_cost;
     Cost worst_target_cost;
     Cost worst_optional_cost;
@@ -330,9 +1818,27 @@ PlanningData::Cost PlanningData::computeCost(Cell *c)
     worst_target_cost.constraint(MyConstraints::COL)=-std::numeric_limits<float>::infinity();
     worst_optional_cost.constraint(MyConstraints::COL)=-std::numeric_limits<float>::infinity();
 
+    //in any target mode, the costs of each mandatory target (the others aggregate only the optional targets)
+    bool any_target = anyTarget && indexFirstOptionalTarget>0;
+    std::vector<Cost> &mandatory_costs=ctx.target_costs;
+
+    if(pair && pair->ready && !ctx.trace){
+        best_target_cost=pair->best_target_cost;
+        worst_target_cost=pair->worst_target_cost;
+        worst_optional_cost=pair->worst_optional_cost;
+        best_target=pair->best_target;
+        worst_target=pair->worst_target;
+        worst_optional=pair->worst_optional;
+        if(any_target) mandatory_costs=pair->mandatory_costs;
+    }else{
+    if(any_target) mandatory_costs.resize(indexFirstOptionalTarget);
     for (uint i=0;i<indexFirstOptionalTarget;++i)
     {
-        Cost t = targetCost(c,i,visib[i],visib_rob[i]);
+        Cost t = targetCost(c,i,visib_h[i],visib_r[i],ctx);
+        if(any_target){
+            mandatory_costs[i]=t;
+            continue;
+        }
         if(t<best_target_cost){
             best_target_cost=t;
             best_target=i;
@@ -348,28 +1854,35 @@ PlanningData::Cost PlanningData::computeCost(Cell *c)
     }
 
     for (uint i=indexFirstOptionalTarget;i<targets.size();++i){
-        Cost t = targetCost(c,i,visib[i],visib_rob[i]);
+        Cost t = targetCost(c,i,visib_h[i],visib_r[i],ctx);
         if(worst_optional_cost<t){
             worst_optional_cost=t;
             worst_optional=i;
         }
     }
+    if(pair){
+        pair->best_target_cost=best_target_cost;
+        pair->worst_target_cost=worst_target_cost;
+        pair->worst_optional_cost=worst_optional_cost;
+        pair->best_target=best_target;
+        pair->worst_target=worst_target;
+        pair->worst_optional=worst_optional;
+        if(any_target) pair->mandatory_costs=mandatory_costs;
+        pair->ready=true;
+    }
+    }
     c->target = best_target;
     float c_dist_r,c_dist_h,c_prox,c_time,c_time_robot;
     int col;
     {
-        float dist_r,dist_h,dist_target{0};
+        float dist_r,dist_h,dist_target;
         float time_ask_to_move{0};
-        std::array<float,2> ah,ar;
-        ar=c->posRobot();
-        ah=c->posHuman();
-        dist_r=distGrid_r.getCostPos(ar);
-        dist_h=distGrid_h.getCostPos(ah);
+        dist_r=terms_r.dist;
+        dist_h=terms_h.dist;
         if(dist_h >= ask_to_move_dist_trigger)
             time_ask_to_move += ask_to_move_duration;
 
-        if(usePhysicalTarget)
-            dist_target=distGrid_physicalTarget.getCostPos(ah);
+        dist_target=terms_h.dist_target;
 
         c_dist_r = std::pow(dist_r+1,kr*kd+1)-1.f;//dist robot
         c_dist_h = std::pow(dist_h+1,kh*kd+1)-1.f;//dist human
@@ -377,45 +1890,61 @@ PlanningData::Cost PlanningData::computeCost(Cell *c)
         c_time = time_guiding + dist_target/sh + time_ask_to_move;
         c_time_robot=time_guiding + dist_r/sr + time_ask_to_move;
 
-        API::CylinderCollision cylinderCol(global_Project->getCollision());
         col = 3;
-        col -= int(freespace_h.getCell(ah));
-        col -= int(freespace_r.getCell(ar));
-        col -= int(cylinderCol.moveCheck(r,Eigen::Vector3d(pr[0],pr[1],0.),h,Eigen::Vector3d(ph[0],ph[1],0.)));
+        col -= int(terms_h.free);
+        col -= int(terms_r.free);
+        col -= int(agentsApart(c,ctx));
     }
     c_prox = std::abs(dp-float((pr-ph).norm())); //proxemics
 
-    cost = (1.f + ktr*c_time_robot + kt*c_time + (ktr+kt)*best_target_cost.cost(MyCosts::TIME) + kv*worst_optional_cost.cost(MyCosts::VISIB))
-            *
-            (std::pow(worst_optional_cost.cost(MyCosts::COST),2.f)+std::pow(worst_target_cost.cost(MyCosts::COST),2.f)) ;
-    if(cost!=cost || cost>=std::numeric_limits<float>::max()){//nan or inf
-        cost=std::numeric_limits<float>::infinity();
-    }
-    float time = std::max(c_time_robot,c_time) + best_target_cost.cost(MyCosts::TIME);
-
-    /*std::map<std::string,double> costDetails = global_costSpace->getCostDetails();
-    //costDetails["angle h"]=     double(c_angle_h);
-    //costDetails["angle r"]=     double(c_angle_r);
-    //costDetails["angle persp"]= double(c_angle_persp);
-    costDetails["0dist r"]=      double(c_dist_r);
-    costDetails["0dist h"]=      double(c_dist_h);
-    costDetails["1time human"]=  double(c_time);
-    costDetails["1time robot"]=  double(c_time_robot);
-    costDetails["2proxemics"]=   double(c_prox);
-    costDetails["2time dir"] =   double(best_target_cost.cost(MyCosts::TIME));
-    //costDetails["visib"]=       double(c_visib);
-    costDetails["2target cost"]= double(worst_optional_cost.cost(MyCosts::COST));
-    global_costSpace->setCostDetails(std::move(costDetails));*/
-
-    c->cost.cost(MyCosts::COST)=cost;
-    c->cost.cost(MyCosts::TIME)=0.f;
+    auto combine=[&](Cost best,Cost worst,Cost worst_optional){
+        Cost k;
+        float cost = (1.f + ktr*c_time_robot + kt*c_time + (ktr+kt)*best.cost(MyCosts::TIME) + kv*worst_optional.cost(MyCosts::VISIB))
+                *
+                (std::pow(worst_optional.cost(MyCosts::COST),2.f)+std::pow(worst.cost(MyCosts::COST),2.f)) ;
+        if(cost!=cost || cost>=std::numeric_limits<float>::max()){//nan or inf
+            cost=std::numeric_limits<float>::infinity();
+        }
+        k.cost(MyCosts::COST)=cost;
+        k.cost(MyCosts::TIME)=0.f;
+        k.constraint(MyConstraints::COL) = col;
+        k.constraint(MyConstraints::VIS) = worst.constraint(MyConstraints::VIS);
+        k.constraint(MyConstraints::DIST) = std::max(0.f,c_prox*c_prox - prox_tol*prox_tol);
+        k.constraint(MyConstraints::RTIME) = std::max(0.f, c_time_robot+best.cost(MyCosts::TIME) - max_time_r);
+        k.constraint(MyConstraints::ANGLE) = worst.constraint(MyConstraints::ANGLE);
+        return k;
+    };
+
+    if(any_target){
+        //each mandatory target is an alternative, with its route time: the cell keeps the best one
+        Cost optional_cost=worst_optional_cost;
+        for(uint i=0;i<indexFirstOptionalTarget;++i){
+            const Cost &t=mandatory_costs[i];
+            const Cost &worst_opt = (optional_cost<t ? t : optional_cost);
+            Cost k=combine(t,t,worst_opt);
+            if(best_target==-1u || k<c->cost){
+                c->cost=k;
+                best_target=i;
+                best_target_cost=worst_target_cost=t;
+                worst_optional_cost=worst_opt;
+            }
+        }
+        c->target = best_target;
+    }else{
+        c->cost=combine(best_target_cost,worst_target_cost,worst_optional_cost);
+    }
+
+    if(ctx.trace){
+        ctx.trace->dist_r=      c_dist_r;
+        ctx.trace->dist_h=      c_dist_h;
+        ctx.trace->time_h=      c_time;
+        ctx.trace->time_r=      c_time_robot;
+        ctx.trace->proxemics=   c_prox;
+        ctx.trace->time_dir=    best_target_cost.cost(MyCosts::TIME);
+        ctx.trace->target_cost= worst_optional_cost.cost(MyCosts::COST);
+    }
 
     c->col = (col!=0);
-    c->cost.constraint(MyConstraints::COL) = col;
-    c->cost.constraint(MyConstraints::VIS) = worst_target_cost.constraint(MyConstraints::VIS);
-    c->cost.constraint(MyConstraints::DIST) = std::max(0.f,c_prox*c_prox - prox_tol*prox_tol);
-    c->cost.constraint(MyConstraints::RTIME) = std::max(0.f, c_time_robot+best_target_cost.cost(MyCosts::TIME) - max_time_r);
-    c->cost.constraint(MyConstraints::ANGLE) = worst_target_cost.constraint(MyConstraints::ANGLE);
     c->vis = c->cost.constraint(MyConstraints::VIS) <=0.f; // if visib is better than ..
 
     return c->cost;
@@ -427,31 +1956,64 @@ std::vector<float> PlanningData::getVisibilites(Robot *r, const Eigen::Vector2d
     Eigen::Affine3d jnt_pos = r->getHriAgent()->perspective->getMatrixPos();
     jnt_pos.translationExt()[0]=pos2d[0];
     jnt_pos.translationExt()[1]=pos2d[1];
-    Eigen::Vector3f pos=jnt_pos.translation().cast<float>();
+    getVisibilites(jnt_pos.translation(),visib);
+    //ogre_rob->getRobotNode()->setVisible(false);
+    //visibEngine->computeVisibilityFrom(jnt_pos);
+    //for ( Robot *t : targets){
+    //    visib.push_back(1.f-1.f/0.007f * float(visibEngine->getVisibilityInFovPercent(t)));
+    //}
+    //ogre_rob->getRobotNode()->setVisible(true);
+    return visib;
+}
+
+void PlanningData::getVisibilites(const Eigen::Vector3d &persp, std::vector<float> &visib)
+{
+    Eigen::Vector3f pos=persp.cast<float>();
     VisibilityGrid3d::SpaceCoord pgrid{{pos[0],pos[1],pos[2]}};
+    visib.clear();
     try{
         VisibilityGrid3d::reference cell=visibilityGrid->getCell(pgrid);
         VisibilityGrid3d::SpaceCoord c =visibilityGrid->getCellCenter(visibilityGrid->getCellCoord(pgrid));
         M3D_TRACE("cell "<<c[0]<<" "<<c[1]<<" "<<c[2]);
         for(uint i=0;i<targets.size();++i){
-            M3D_TRACE("\t"<<targets[i]->getName()<<" "<<cell[targets[i]]);
-            visib.push_back(1.f-cell[targets[i]]);
+            //find() rather than operator[]: the cell is shared between the threads
+            auto it=cell.find(targets[i]);
+            float v = (it==cell.end() ? 0.f : it->second);
+            M3D_TRACE("\t"<<targets[i]->getName()<<" "<<v);
+            visib.push_back(1.f-v);
         }
     }catch(VisibilityGrid3d::out_of_grid &){
         visib.assign(targets.size(),1.f);
     }
-    //ogre_rob->getRobotNode()->setVisible(false);
-    //visibEngine->computeVisibilityFrom(jnt_pos);
-    //for ( Robot *t : targets){
-    //    visib.push_back(1.f-1.f/0.007f * float(visibEngine->getVisibilityInFovPercent(t)));
-    //}
-    //ogre_rob->getRobotNode()->setVisible(true);
-    return visib;
+}
+
+void PlanningData::updateAgentFrames()
+{
+    if(snapshot){
+        targetPos=snapshot->targetPos;
+        targetPos2d=snapshot->targetPos2d;
+        return;
+    }
+    targetPos.clear();
+    targetPos2d.clear();
+    for(Robot *t : targets){
+        targetPos.push_back(t->getJoint(0)->getVectorPos());
+        targetPos2d.push_back(m3dGeometry::getConfBase2DPos(*t->getCurrentPos()));
+    }
+}
+
+Eigen::Vector3d PlanningData::perspectivePos(const Eigen::Vector3d &offset, const Eigen::Vector2d &pos2d, double yaw) const
+{
+    return Eigen::Vector3d(pos2d[0],pos2d[1],0.) + Eigen::AngleAxisd(yaw,Eigen::Vector3d::UnitZ()) * offset;
 }
 
 float PlanningData::computeStateCost(RobotState &q)
 {
-    reinit();
+    refresh();
+    if(!pre){
+        M3D_INFO("PlanningData::computeStateCost: no navigation grids for the current initial positions");
+        return 0.f;
+    }
     if(q.getRobot() == r){
         Grid::ArrayCoord coord{{0,0,0,0}};
         Grid::SpaceCoord pos;
@@ -503,6 +2065,53 @@ float PlanningData::computeStateCost(RobotState &q)
     }
     return 0.f;
 }
+std::vector<PlanningData::StateEvaluation> PlanningData::computeStatesCost(const Positions2d &robot_pos, const Positions2d &human_pos)
+{
+    assert(robot_pos.size()==human_pos.size());
+    refresh();
+    std::vector<StateEvaluation> results(std::min(robot_pos.size(),human_pos.size()));
+    if(!pre){
+        M3D_INFO("PlanningData::computeStatesCost: no navigation grids for the current initial positions");
+        return results;
+    }
+    WorkerPool pool(threads);
+    std::vector<EvalContext> contexts(pool.size());
+    pool.parallelFor(results.size(),[&](size_t i,unsigned int worker){
+        EvalContext &ctx=contexts[worker];
+        StateEvaluation &res=results[i];
+        Grid::SpaceCoord pos{{float(robot_pos[i][0]),float(robot_pos[i][1]),float(human_pos[i][0]),float(human_pos[i][1])}};
+        Cell c(Grid::ArrayCoord{{0,0,0,0}},pos);
+        AgentTerms terms_r,terms_h;
+        res.cost=0.f;
+        ctx.visib.clear();
+        ctx.visib_rob.clear();
+        try{
+            computeAgentTerms(0,c.vPosRobot(),terms_r,ctx.visib_rob);
+            computeAgentTerms(1,c.vPosHuman(),terms_h,ctx.visib);
+            res.cost=combineCost(&c,terms_r,ctx.visib_rob.data(),terms_h,ctx.visib.data(),ctx).toDouble();
+        }catch(std::out_of_range &e){
+            M3D_DEBUG("out_of_range in PointingPlanner::PlanningData::computeStatesCost "<<e.what());
+        }
+        res.visib_h = (ctx.visib.size() ? ctx.visib[0] : 0.f);
+        res.visib_r = (ctx.visib_rob.size() ? ctx.visib_rob[0] : 0.f);
+    });
+    return results;
+}
+
+std::vector<PlanningData::StateEvaluation> PlanningData::computeStatesCost(const std::vector<RobotState> &robot_states, const std::vector<RobotState> &human_states)
+{
+    Positions2d robot_pos,human_pos;
+    robot_pos.reserve(robot_states.size());
+    human_pos.reserve(human_states.size());
+    for(const RobotState &q : robot_states){
+        robot_pos.push_back(m3dGeometry::getConfBase2DPos(q));
+    }
+    for(const RobotState &q : human_states){
+        human_pos.push_back(m3dGeometry::getConfBase2DPos(q));
+    }
+    return computeStatesCost(robot_pos,human_pos);
+}
+
 float PlanningData::computeStateVisiblity(RobotState &state){
     getParameters();
     Robot *r=state.getRobot();
@@ -557,7 +2166,7 @@ float PlanningData::visibility(uint target_i, const Eigen::Vector3d &pos){
     }
 }
 
-PlanningData::PlanningData(Robot *r, Robot *h):
+PlanningData::PlanningData(Robot *r, Robot *h, bool init):
     r(r),h(h)
 {
     visibilityGrid=dynamic_cast<VisibilityGridLoader*>(ModuleRegister::getInstance()->module(VisibilityGridLoader::name()))->grid();
@@ -566,7 +2175,7 @@ PlanningData::PlanningData(Robot *r, Robot *h):
 
     //visibEngine = new MoveOgre::VisibilityEngine(Ogre::Degree(360.f),Ogre::Degree(90.f),64u);
 
-    reinit();
+    if(init) reinit();
 
 }
 
@@ -575,6 +2184,11 @@ PlanningData::~PlanningData()
     //delete visibEngine;
 }
 
+PlanningData::EvalContext::EvalContext():
+    collision(new API::CylinderCollision(global_Project->getCollision()))
+{
+}
+
 void PlanningData::getParameters()
 {
     API::Parameter::lock_t lock;
@@ -595,6 +2209,111 @@ void PlanningData::getParameters()
     vis_threshold=API::Parameter::root(lock)["PointingPlanner"]["vis_threshold"].asDouble();
     desired_angle_h=API::Parameter::root(lock)["PointingPlanner"]["desired_angle_h"].asDouble();
     desired_angle_h_tolerance=API::Parameter::root(lock)["PointingPlanner"]["desired_angle_h_tolerance"].asDouble();
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("threads"))
+        threads=API::Parameter::root(lock)["PointingPlanner"]["threads"].asInt();
+    else
+        threads=0;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("visibility_pruning"))
+        visibilityPruning=API::Parameter::root(lock)["PointingPlanner"]["visibility_pruning"].asBool();
+    else
+        visibilityPruning=false;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("region_pruning"))
+        regionPruning=API::Parameter::root(lock)["PointingPlanner"]["region_pruning"].asBool();
+    else
+        regionPruning=false;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("doorway_width"))
+        doorwayWidth=API::Parameter::root(lock)["PointingPlanner"]["doorway_width"].asDouble();
+    else
+        doorwayWidth=1.2f;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("refine"))
+        refine=API::Parameter::root(lock)["PointingPlanner"]["refine"].asBool();
+    else
+        refine=false;
+    group.clear();
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("group")){
+        API::Parameter &pgroup = API::Parameter::root(lock)["PointingPlanner"]["group"];
+        for(uint i=0;i<pgroup.size();++i){
+            Robot *human=global_Project->getActiveScene()->getRobotByName(pgroup[i].asString());
+            if(human)
+                group.push_back(human);
+            else
+                M3D_ERROR("human not found ("<<pgroup[i].asString()<<")");
+        }
+    }
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("group_candidates"))
+        groupCandidates=std::max(1,API::Parameter::root(lock)["PointingPlanner"]["group_candidates"].asInt());
+    else
+        groupCandidates=20;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("group_separation"))
+        groupSeparation=API::Parameter::root(lock)["PointingPlanner"]["group_separation"].asDouble();
+    else
+        groupSeparation=0.6f;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("engine"))
+        engine=engineFromName(API::Parameter::root(lock)["PointingPlanner"]["engine"].asString());
+    else
+        engine=Engine::LATTICE;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("sampling_samples"))
+        samplingSamples=std::max(1,API::Parameter::root(lock)["PointingPlanner"]["sampling_samples"].asInt());
+    else
+        samplingSamples=2000;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("sampling_seed"))
+        samplingSeed=API::Parameter::root(lock)["PointingPlanner"]["sampling_seed"].asInt();
+    else
+        samplingSeed=0;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("move_set"))
+        moveSet=moveSetFromName(API::Parameter::root(lock)["PointingPlanner"]["move_set"].asString());
+    else
+        moveSet=MoveSet::FULL;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("multires_levels"))
+        multiresLevels=std::max(0,std::min(8,API::Parameter::root(lock)["PointingPlanner"]["multires_levels"].asInt()));
+    else
+        multiresLevels=0;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("multires_candidates"))
+        multiresCandidates=std::max(1,API::Parameter::root(lock)["PointingPlanner"]["multires_candidates"].asInt());
+    else
+        multiresCandidates=3;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("any_target"))
+        anyTarget=API::Parameter::root(lock)["PointingPlanner"]["any_target"].asBool();
+    else
+        anyTarget=false;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("alternatives"))
+        alternativesCount=std::max(0,API::Parameter::root(lock)["PointingPlanner"]["alternatives"].asInt());
+    else
+        alternativesCount=0;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("alternatives_separation"))
+        alternativesSeparation=API::Parameter::root(lock)["PointingPlanner"]["alternatives_separation"].asDouble();
+    else
+        alternativesSeparation=1.f;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("incremental"))
+        incremental=API::Parameter::root(lock)["PointingPlanner"]["incremental"].asBool();
+    else
+        incremental=false;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("deadline"))
+        deadline=API::Parameter::root(lock)["PointingPlanner"]["deadline"].asDouble();
+    else
+        deadline=0.f;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("grids_cache"))
+        useGridsCache=API::Parameter::root(lock)["PointingPlanner"]["grids_cache"].asBool();
+    else
+        useGridsCache=true;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("footprint_radius_robot") && API::Parameter::root(lock)["PointingPlanner"].hasKey("footprint_radius_human")){
+        footprintRadius_r=API::Parameter::root(lock)["PointingPlanner"]["footprint_radius_robot"].asDouble();
+        footprintRadius_h=API::Parameter::root(lock)["PointingPlanner"]["footprint_radius_human"].asDouble();
+    }else{
+        footprintRadius_r=footprintRadius_h=-1.f;
+    }
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("scene_revision"))
+        sceneRevision=API::Parameter::root(lock)["PointingPlanner"]["scene_revision"].asInt();
+    else
+        sceneRevision=0;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("result_cache"))
+        resultCacheSize=std::max(0,API::Parameter::root(lock)["PointingPlanner"]["result_cache"].asInt());
+    else
+        resultCacheSize=0;
+    if(API::Parameter::root(lock)["PointingPlanner"].hasKey("result_cache_resolution"))
+        resultCacheResolution=API::Parameter::root(lock)["PointingPlanner"]["result_cache_resolution"].asDouble();
+    else
+        resultCacheResolution=0.1f;
     usePhysicalTarget=API::Parameter::root(lock)["PointingPlanner"]["use_physical_target"].asBool();
     if ( API::Parameter::root(lock)["PointingPlanner"]["physical_target_pos"].type() == API::Parameter::ArrayValue){
         physicalTarget[0]=API::Parameter::root(lock)["PointingPlanner"]["physical_target_pos"][0].asDouble();
@@ -636,8 +2355,8 @@ void PlanningData::getParameters()
 
 void PlanningData::resetFromCurrentInitPos()
 {
-    start_r = *r->getInitialPosition();
-    start_h = *h->getInitialPosition();
+    start_r = (snapshot ? snapshot->start_r : *r->getInitialPosition());
+    start_h = (snapshot ? snapshot->start_h : *h->getInitialPosition());
 
     start_p_r = m3dGeometry::getConfBase2DPos(start_r);
     start_p_h = m3dGeometry::getConfBase2DPos(start_h);
@@ -645,41 +2364,194 @@ void PlanningData::resetFromCurrentInitPos()
     balls=std::shared_ptr<Graphic::LinkedBalls2d>(new Graphic::LinkedBalls2d);
     balls->name="PointingPlanner";
 
-    initCollisionGrids();
-    API::ndGridAlgo::Dijkstra<API::nDimGrid<bool,2>,float>::SpaceCoord fromr,fromh,phyTargetPos;
-    fromr[0]=start_p_r[0];
-    fromr[1]=start_p_r[1];
-    fromh[0]=start_p_h[0];
-    fromh[1]=start_p_h[1];
-    phyTargetPos[0]=physicalTarget[0];
-    phyTargetPos[1]=physicalTarget[1];
-    try{
-        distGrid_r = API::ndGridAlgo::Dijkstra<API::nDimGrid<bool,2>,float>(&freespace_r,freespace_r.getCellCoord(fromr));
-    }catch(Grid::out_of_grid &e){
-        M3D_INFO("cannot compute the dijkstra for the robot, from "<<fromr[0]<<","<<fromr[1]);
-        throw e;
-    }
-    try{
-        distGrid_h = API::ndGridAlgo::Dijkstra<API::nDimGrid<bool,2>,float>(&freespace_h,freespace_h.getCellCoord(fromh));
-    }catch(Grid::out_of_grid &e){
-        M3D_INFO("cannot compute the dijkstra for the human, from "<<fromh[0]<<","<<fromh[1]);
-        throw e;
+    PrecomputationKey key=precomputationKey();
+    if(!pre || !(pre->key==key)){
+        pre=borrowPrecomputation(key);
     }
+    if(!snapshot){
+    Graphic::DrawablePool::sAddGrid2Dfloat(std::shared_ptr<Graphic::Grid2Dfloat>(new Graphic::Grid2Dfloat{"collision human",API::nDimGrid<float,2>(pre->freespace_h)}));
+    Graphic::DrawablePool::sAddGrid2Dfloat(std::shared_ptr<Graphic::Grid2Dfloat>(new Graphic::Grid2Dfloat{"collision robot",API::nDimGrid<float,2>(pre->freespace_r)}));
+    Graphic::DrawablePool::sAddGrid2Dfloat(std::shared_ptr<Graphic::Grid2Dfloat>(new Graphic::Grid2Dfloat{"distance human",API::nDimGrid<float,2>(pre->distGrid_h.getGrid()),true}));
+    Graphic::DrawablePool::sAddGrid2Dfloat(std::shared_ptr<Graphic::Grid2Dfloat>(new Graphic::Grid2Dfloat{"distance robot",API::nDimGrid<float,2>(pre->distGrid_r.getGrid()),true}));
     if(usePhysicalTarget)
+        Graphic::DrawablePool::sAddGrid2Dfloat(std::shared_ptr<Graphic::Grid2Dfloat>(new Graphic::Grid2Dfloat{"distance target",API::nDimGrid<float,2>(pre->distGrid_physicalTarget.getGrid()),true}));
+    }
+
+    precomputed=key;
+    ++precomputationVersion;
+}
+
+namespace {
+/// precomputations still in use by some PlanningData
+std::mutex sharedPrecomputationsMutex;
+std::vector<std::weak_ptr<PlanningData::Precomputation> > sharedPrecomputations;
+/// the last one built is kept even when unused, for the successive short lived PlanningData
+std::shared_ptr<PlanningData::Precomputation> lastPrecomputation;
+/// precomputations being built (outside of the lock), set when the build ended
+std::vector<std::pair<PlanningData::PrecomputationKey,std::shared_future<void> > > pendingPrecomputations;
+}
+
+std::shared_ptr<PlanningData::Precomputation> PlanningData::borrowPrecomputation(const PrecomputationKey &key)
+{
+    //the lock only protects the lists, the builds run concurrently. A request for a key being built waits for it
+    //instead of doing it twice, as one of the same scene when nothing of that scene is ready to be shared
+    std::promise<void> built;
+    std::shared_ptr<Precomputation> same_scene;
+    for(;;){
+        std::shared_future<void> pending;
+        {
+        std::lock_guard<std::mutex> lock(sharedPrecomputationsMutex);
+        //another precomputation of the same scene only differs by the navigation distances
+        same_scene.reset();
+        if(pre && pre->key.sameScene(key)) same_scene=pre;
+        for(auto it=sharedPrecomputations.begin();it!=sharedPrecomputations.end();){
+            std::shared_ptr<Precomputation> p=it->lock();
+            if(!p){
+                it=sharedPrecomputations.erase(it);
+                continue;
+            }
+            if(p->key==key){
+                M3D_DEBUG("PlanningData: reusing the precomputed grids");
+                return p;
+            }
+            if(!same_scene && p->key.sameScene(key)) same_scene=p;
+            ++it;
+        }
+        for(auto &p : pendingPrecomputations){
+            if(p.first==key || (!same_scene && p.first.sameScene(key))){
+                pending=p.second;
+                break;
+            }
+        }
+        if(!pending.valid()){
+            pendingPrecomputations.push_back(std::make_pair(key,built.get_future().share()));
+            break;
+        }
+        }
+        //then look again (a failed build is done again by this one)
+        pending.wait();
+    }
+
+    std::shared_ptr<Precomputation> p(new Precomputation);
+    p->key=key;
+    //to be called locked
+    auto done=[&](){
+        for(auto it=pendingPrecomputations.begin();it!=pendingPrecomputations.end();++it){
+            if(it->first==key){
+                pendingPrecomputations.erase(it);
+                break;
+            }
+        }
+    };
     try{
-        distGrid_physicalTarget= API::ndGridAlgo::Dijkstra<API::nDimGrid<bool,2>,float>(&freespace_h,freespace_h.getCellCoord(phyTargetPos));
-    }catch(Grid::out_of_grid &e){
-        M3D_INFO("cannot compute the dijkstra to the target, from "<<phyTargetPos[0]<<","<<phyTargetPos[1]);
-        throw e;
+        buildPrecomputation(*p,same_scene);
+    }catch(...){
+        {
+        std::lock_guard<std::mutex> lock(sharedPrecomputationsMutex);
+        done();
+        }
+        built.set_value();
+        throw;
     }
-    Graphic::DrawablePool::sAddGrid2Dfloat(std::shared_ptr<Graphic::Grid2Dfloat>(new Graphic::Grid2Dfloat{"distance human",API::nDimGrid<float,2>(distGrid_h.getGrid()),true}));
-    Graphic::DrawablePool::sAddGrid2Dfloat(std::shared_ptr<Graphic::Grid2Dfloat>(new Graphic::Grid2Dfloat{"distance robot",API::nDimGrid<float,2>(distGrid_r.getGrid()),true}));
-    if(usePhysicalTarget)
-        Graphic::DrawablePool::sAddGrid2Dfloat(std::shared_ptr<Graphic::Grid2Dfloat>(new Graphic::Grid2Dfloat{"distance target",API::nDimGrid<float,2>(distGrid_physicalTarget.getGrid()),true}));
+    {
+    std::lock_guard<std::mutex> lock(sharedPrecomputationsMutex);
+    sharedPrecomputations.push_back(p);
+    lastPrecomputation=p;
+    done();
+    }
+    built.set_value();
+    return p;
+}
+
+void PlanningData::clearSharedPrecomputations()
+{
+    std::lock_guard<std::mutex> lock(sharedPrecomputationsMutex);
+    sharedPrecomputations.clear();
+    lastPrecomputation.reset();
+}
+
+void PlanningData::buildPrecomputation(Precomputation &pre, const std::shared_ptr<Precomputation> &same_scene)
+{
+    if(same_scene){
+        pre.perspectiveOffset_r=same_scene->perspectiveOffset_r;
+        pre.perspectiveOffset_h=same_scene->perspectiveOffset_h;
+        pre.freespace_r=same_scene->freespace_r;
+        pre.freespace_h=same_scene->freespace_h;
+        pre.nx=same_scene->nx;
+        pre.ny=same_scene->ny;
+        pre.agentsClearance=same_scene->agentsClearance;
+        pre.slices=same_scene->slices;
+        pre.regions=same_scene->regions;
+    }else{
+        for(uint i=0;i<2;++i){
+            Robot *a = (i==0 ? r : h);
+            RobotState q;
+            Eigen::Vector3d p;
+            if(snapshot){
+                q = (i==0 ? snapshot->current_r : snapshot->current_h);
+                p = (i==0 ? snapshot->perspective_r : snapshot->perspective_h);
+            }else{
+                q = *a->getCurrentPos();
+                p = a->getHriAgent()->perspective->getVectorPos();
+            }
+            p[0]-=q[6];
+            p[1]-=q[7];
+            (i==0 ? pre.perspectiveOffset_r : pre.perspectiveOffset_h) = Eigen::AngleAxisd(-q[11],Eigen::Vector3d::UnitZ()) * p;
+        }
+
+        std::string cache_path = (useGridsCache ? gridsCachePath() : std::string());
+        if(cache_path.empty() || !loadGridsCache(pre,cache_path)){
+            initCollisionGrids(pre);
+            //depends only on the agent cylinders
+            calibrateAgentsClearance(pre);
+            //a failed calibration is not saved, it is tried again next time
+            if(!cache_path.empty() && pre.agentsClearance>=0.f){
+                saveGridsCache(pre,cache_path);
+            }
+        }
+        pre.slices=std::make_shared<Precomputation::VisibilitySlices>();
+        pre.regions=std::make_shared<Precomputation::RegionMaps>();
+    }
+
+    API::nDimGrid<bool,2>::SpaceCoord fromr,fromh,phyTargetPos;
+    fromr[0]=pre.key.start_r[0];
+    fromr[1]=pre.key.start_r[1];
+    fromh[0]=pre.key.start_h[0];
+    fromh[1]=pre.key.start_h[1];
+    phyTargetPos[0]=pre.key.physicalTarget[0];
+    phyTargetPos[1]=pre.key.physicalTarget[1];
+    //complete: a cell within max_dist as the crow flies (see isTooFar) may be farther by the free space.
+    //The three are independent
+    WorkerPool pool(threads);
+    pool.parallelFor(pre.key.usePhysicalTarget ? 3 : 2,[&](size_t i,unsigned int){
+        if(i==0){
+            try{
+                pre.distGrid_r = DistanceField2d(pre.freespace_r,pre.freespace_r.getCellCoord(fromr));
+            }catch(Grid::out_of_grid &e){
+                M3D_INFO("cannot compute the dijkstra for the robot, from "<<fromr[0]<<","<<fromr[1]);
+                throw e;
+            }
+        }else if(i==1){
+            try{
+                pre.distGrid_h = DistanceField2d(pre.freespace_h,pre.freespace_h.getCellCoord(fromh));
+            }catch(Grid::out_of_grid &e){
+                M3D_INFO("cannot compute the dijkstra for the human, from "<<fromh[0]<<","<<fromh[1]);
+                throw e;
+            }
+        }else{
+            try{
+                pre.distGrid_physicalTarget = DistanceField2d(pre.freespace_h,pre.freespace_h.getCellCoord(phyTargetPos));
+            }catch(Grid::out_of_grid &e){
+                M3D_INFO("cannot compute the dijkstra to the target, from "<<phyTargetPos[0]<<","<<phyTargetPos[1]);
+                throw e;
+            }
+        }
+    });
 }
 
 void PlanningData::reinit(){
     getParameters();
+    updateAgentFrames();
     try{
     resetFromCurrentInitPos();
     }catch (Grid::out_of_grid &e){
@@ -687,7 +2559,60 @@ void PlanningData::reinit(){
     }
 }
 
-void PlanningData::initCollisionGrids()
+bool PlanningData::refresh()
+{
+    getParameters();
+    updateAgentFrames();
+    if(precomputationVersion && precomputationKey()==precomputed){
+        return false;
+    }
+    try{
+    resetFromCurrentInitPos();
+    }catch (Grid::out_of_grid &e){
+        M3D_INFO("out of grid in PlanningData::refresh, won't work for now");
+    }
+    return true;
+}
+
+PlanningData::PrecomputationKey PlanningData::precomputationKey() const
+{
+    PrecomputationKey key;
+    key.sceneRevision=sceneRevision;
+    key.gridRevision=dynamic_cast<VisibilityGridLoader*>(ModuleRegister::getInstance()->module(VisibilityGridLoader::name()))->revision();
+    key.staticObstacles=(snapshot ? snapshot->staticObstacles : staticObstaclesHash());
+    key.movableObstacles=(snapshot ? snapshot->movableObstacles : movableObstaclesHash());
+    key.r=r;
+    key.h=h;
+    key.start_r=m3dGeometry::getConfBase2DPos(snapshot ? snapshot->start_r : *r->getInitialPosition());
+    key.start_h=m3dGeometry::getConfBase2DPos(snapshot ? snapshot->start_h : *h->getInitialPosition());
+    key.usePhysicalTarget=usePhysicalTarget;
+    key.physicalTarget=physicalTarget;
+    key.bounds=global_Project->getActiveScene()->getBounds();
+    key.visibilityGrid=visibilityGrid;
+    key.cellSize=visibilityGrid->getCellSize();
+    key.footprintRadius_r=footprintRadius_r;
+    key.footprintRadius_h=footprintRadius_h;
+    return key;
+}
+
+bool PlanningData::PrecomputationKey::operator==(const PrecomputationKey &other) const
+{
+    return sameScene(other) &&
+            start_r==other.start_r && start_h==other.start_h &&
+            usePhysicalTarget==other.usePhysicalTarget &&
+            (!usePhysicalTarget || physicalTarget==other.physicalTarget);
+}
+
+bool PlanningData::PrecomputationKey::sameScene(const PrecomputationKey &other) const
+{
+    return sceneRevision==other.sceneRevision && gridRevision==other.gridRevision &&
+            staticObstacles==other.staticObstacles && movableObstacles==other.movableObstacles &&
+            r==other.r && h==other.h &&
+            bounds==other.bounds && visibilityGrid==other.visibilityGrid && cellSize==other.cellSize &&
+            footprintRadius_r==other.footprintRadius_r && footprintRadius_h==other.footprintRadius_h;
+}
+
+void PlanningData::initCollisionGrids(Precomputation &pre)
 {
     VisibilityGrid3d::SpaceCoord vis_cell_size=visibilityGrid->getCellSize();
     API::nDimGrid<bool,2>::SpaceCoord cell_size;
@@ -699,13 +2624,46 @@ void PlanningData::initCollisionGrids()
     envSize[2]=global_Project->getActiveScene()->getBounds()[2]; //y min
     envSize[3]=global_Project->getActiveScene()->getBounds()[3]; //y max
     bool adjust=false;
-    freespace_h=API::nDimGrid<bool,2>(cell_size,adjust,envSize);
-    freespace_r=API::nDimGrid<bool,2>(cell_size,adjust,envSize);
-    initCollisionGrid(freespace_h,h);
-    initCollisionGrid(freespace_r,r);
+    pre.freespace_h=API::nDimGrid<bool,2>(cell_size,adjust,envSize);
+    pre.freespace_r=API::nDimGrid<bool,2>(cell_size,adjust,envSize);
+    API::nDimGrid<bool,2>::ArrayCoord last=pre.freespace_h.getCellCoord(pre.freespace_h.getNumberOfCells()-1);
+    pre.nx=last[0]+1;
+    pre.ny=last[1]+1;
+    if(footprintRadius_r>=0.f && footprintRadius_h>=0.f){
+        initCollisionGridsFromFootprint(pre);
+    }else{
+        initCollisionGrid(pre.freespace_h,h);
+        initCollisionGrid(pre.freespace_r,r);
+    }
+}
 
-    Graphic::DrawablePool::sAddGrid2Dfloat(std::shared_ptr<Graphic::Grid2Dfloat>(new Graphic::Grid2Dfloat{"collision human",API::nDimGrid<float,2>(freespace_h)}));
-    Graphic::DrawablePool::sAddGrid2Dfloat(std::shared_ptr<Graphic::Grid2Dfloat>(new Graphic::Grid2Dfloat{"collision robot",API::nDimGrid<float,2>(freespace_r)}));
+void PlanningData::initCollisionGridsFromFootprint(Precomputation &pre)
+{
+    //only the agent with the smallest footprint is checked for collision,
+    //the cells blocked for it are the obstacles inflated by its radius
+    bool robot_smaller = footprintRadius_r<=footprintRadius_h;
+    API::nDimGrid<bool,2> &small = (robot_smaller ? pre.freespace_r : pre.freespace_h);
+    API::nDimGrid<bool,2> &large = (robot_smaller ? pre.freespace_h : pre.freespace_r);
+    initCollisionGrid(small,(robot_smaller ? r : h));
+
+    std::vector<unsigned char> occupied(pre.nx*pre.ny);
+    for(uint i=0;i<small.getNumberOfCells();++i){
+        API::nDimGrid<bool,2>::ArrayCoord coord=small.getCellCoord(i);
+        occupied[coord[0]+pre.nx*coord[1]] = !small[i];
+    }
+    std::vector<float> dist2;
+    WorkerPool pool(threads);
+    DistanceTransform(pre.nx,pre.ny,small.getCellSize()[0],small.getCellSize()[1]).computeSquared(occupied,dist2,pool);
+
+    //the larger agent collides where the smaller one is closer than the difference of radii to a blocked position.
+    //The distances are between cell centers: a blocked cell may be blocked only up to its border, hence the half diagonal
+    //added to stay conservative (the collision check being replaced is exact)
+    float margin=std::abs(footprintRadius_r-footprintRadius_h) +
+            0.5f*std::hypot(small.getCellSize()[0],small.getCellSize()[1]);
+    for(uint i=0;i<large.getNumberOfCells();++i){
+        API::nDimGrid<bool,2>::ArrayCoord coord=large.getCellCoord(i);
+        large[i] = dist2[coord[0]+pre.nx*coord[1]] > margin*margin;
+    }
 }
 
 void PlanningData::initCollisionGrid(API::nDimGrid<bool,2> &grid, Robot *a)
@@ -713,6 +2671,7 @@ void PlanningData::initCollisionGrid(API::nDimGrid<bool,2> &grid, Robot *a)
     API::CollisionInterface *coll=global_Project->getCollision();
     assert(coll);
     API::CylinderCollision cylinderColl(coll);
+    std::lock_guard<std::mutex> lock(collisionMutex);
     for(uint i=0;i<grid.getNumberOfCells();++i){
         API::nDimGrid<bool,2>::SpaceCoord c = grid.getCellCenter(grid.getCellCoord(i));
         Eigen::Vector3d p{c[0],c[1],0.};
@@ -722,4 +2681,256 @@ void PlanningData::initCollisionGrid(API::nDimGrid<bool,2> &grid, Robot *a)
 
 }
 
+namespace {
+/// FNV-1a, stable from one process to the other
+uint64_t hashString(const std::string &str)
+{
+    uint64_t hash=14695981039346656037ull;
+    for(unsigned char c : str){
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+/// version of the format of the grids cache files
+const unsigned int gridsCacheVersion=3;
+/// radius of an agent cylinder, from the bounding box of its geometry (negative if unknown)
+float cylinderRadius(Robot *cyl)
+{
+    p3d_rob *rob = (cyl ? cyl->getRobotStruct() : nullptr);
+    double radius=-1.;
+    for(int i=0;rob && i<rob->no;++i){
+        const p3d_BB &bb=rob->o[i]->BB;
+        radius=std::max(radius,std::max(bb.xmax-bb.xmin,bb.ymax-bb.ymin)/2);
+    }
+    return radius;
+}
+}
+
+namespace {
+/// results of run() shared by all the PlanningData, the most recently used first
+std::mutex resultCacheMutex;
+typedef std::list<std::pair<uint64_t,std::shared_ptr<const PlanningData::CachedResult> > > ResultList;
+ResultList resultCache;
+std::unordered_map<uint64_t,ResultList::iterator> resultCacheIndex;
+/// revisions of the scene and of the visibility grid of the cached results
+std::pair<unsigned long,unsigned long> resultCacheRevisions;
+PlanningData::ResultCacheStats resultCacheCounters;
+}
+
+uint64_t PlanningData::resultCacheKey() const
+{
+    std::ostringstream key;
+    key<<std::setprecision(9);
+    key<<sceneRevision<<";"<<dynamic_cast<VisibilityGridLoader*>(ModuleRegister::getInstance()->module(VisibilityGridLoader::name()))->revision()<<";";
+    key<<staticObstaclesHash()<<";"<<movableObstaclesHash()<<";";
+    key<<r->getName()<<";"<<h->getName()<<";";
+    auto quantized=[&](double v){key<<long(std::floor(v/resultCacheResolution))<<",";};
+    for(uint agent=0;agent<2;++agent){
+        Eigen::Vector2d p=m3dGeometry::getConfBase2DPos(snapshot ? (agent==0 ? snapshot->start_r : snapshot->start_h) :
+                                                                 *(agent==0 ? r : h)->getInitialPosition());
+        quantized(p[0]);
+        quantized(p[1]);
+    }
+    key<<";";
+    for(uint i=0;i<targets.size();++i){
+        key<<targets[i]->getName()<<":";
+        for(uint k=0;k<3;++k) quantized(targetPos[i][k]);
+        if(i<routeDirTimes.size()) key<<routeDirTimes[i];
+        key<<";";
+    }
+    key<<indexFirstOptionalTarget<<";"<<anyTarget<<";";
+    for(float p : {mr,mh,sh,sr,kt,ktr,ka,kp,dp,prox_tol,kd,kv,max_dist,max_time_r,vis_threshold,desired_angle_h,desired_angle_h_tolerance,
+                   ask_to_move_dist_trigger,ask_to_move_duration,footprintRadius_r,footprintRadius_h,alternativesSeparation,doorwayWidth}){
+        key<<p<<",";
+    }
+    key<<";"<<usePhysicalTarget;
+    if(usePhysicalTarget) key<<physicalTarget[0]<<","<<physicalTarget[1];
+    key<<";"<<int(engine)<<","<<samplingSamples<<","<<samplingSeed<<","<<int(moveSet)<<","<<multiresLevels<<","<<multiresCandidates<<","
+       <<alternativesCount<<","<<refine<<","<<visibilityPruning<<","<<regionPruning;
+    return hashString(key.str());
+}
+
+std::shared_ptr<const PlanningData::CachedResult> PlanningData::findCachedResult(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(resultCacheMutex);
+    auto it=resultCacheIndex.find(key);
+    if(it==resultCacheIndex.end()){
+        ++resultCacheCounters.misses;
+        return std::shared_ptr<const CachedResult>();
+    }
+    ++resultCacheCounters.hits;
+    resultCache.splice(resultCache.begin(),resultCache,it->second);
+    return it->second->second;
+}
+
+void PlanningData::storeCachedResult(uint64_t key, const CachedResult &result, size_t capacity,
+                                     unsigned long scene_revision, unsigned long grid_revision)
+{
+    std::lock_guard<std::mutex> lock(resultCacheMutex);
+    std::pair<unsigned long,unsigned long> revisions(scene_revision,grid_revision);
+    if(revisions!=resultCacheRevisions){
+        //the scene or the grid was reloaded: the other results are not valid anymore
+        resultCache.clear();
+        resultCacheIndex.clear();
+        resultCacheRevisions=revisions;
+    }
+    auto it=resultCacheIndex.find(key);
+    if(it!=resultCacheIndex.end()){
+        resultCache.erase(it->second);
+    }
+    resultCache.push_front(std::make_pair(key,std::make_shared<const CachedResult>(result)));
+    resultCacheIndex[key]=resultCache.begin();
+    while(resultCache.size()>capacity){
+        resultCacheIndex.erase(resultCache.back().first);
+        resultCache.pop_back();
+    }
+}
+
+void PlanningData::clearResultCache()
+{
+    std::lock_guard<std::mutex> lock(resultCacheMutex);
+    resultCache.clear();
+    resultCacheIndex.clear();
+    resultCacheCounters=ResultCacheStats();
+}
+
+PlanningData::ResultCacheStats PlanningData::resultCacheStats()
+{
+    std::lock_guard<std::mutex> lock(resultCacheMutex);
+    ResultCacheStats stats=resultCacheCounters;
+    stats.size=resultCache.size();
+    return stats;
+}
+
+std::string PlanningData::gridsCachePath() const
+{
+    std::string vis_path=DatabaseReader::getInstance()->findFile("visibility_grid_bin");
+    if(vis_path.empty()) vis_path=DatabaseReader::getInstance()->findFile("visibility_grid_bin.txt");
+    if(vis_path.empty()) return std::string();
+    std::string dir=vis_path.substr(0,vis_path.find_last_of('/')+1);
+
+    //one file per pair of agents, overwritten when the grids change (see gridsCacheKey())
+    std::ostringstream name;
+    name<<dir<<"pointing_planner_grids_"<<std::hex<<std::setw(16)<<std::setfill('0')<<hashString(r->getName()+";"+h->getName())<<"_bin";
+    return name.str();
+}
+
+uint64_t PlanningData::gridsCacheKey() const
+{
+    //everything the collision grids depend on: the obstacles, the agent radii and the grid
+    std::ostringstream key;
+    key<<std::setprecision(9)<<gridsCacheVersion<<";"<<sceneRevision<<";";
+    for(double b : global_Project->getActiveScene()->getBounds()) key<<b<<",";
+    VisibilityGrid3d::SpaceCoord cell_size=visibilityGrid->getCellSize();
+    key<<";"<<cell_size[0]<<","<<cell_size[1]<<";";
+    key<<(footprintRadius_r>=0.f ? footprintRadius_r : cylinderRadius(cyl_r))<<","
+       <<(footprintRadius_h>=0.f ? footprintRadius_h : cylinderRadius(cyl_h))<<";";
+    key<<staticObstaclesHash()<<";"<<(snapshot ? snapshot->movableObstacles : movableObstaclesHash());
+    return hashString(key.str());
+}
+
+uint64_t PlanningData::staticObstaclesHash()
+{
+    std::ostringstream key;
+    key<<std::setprecision(9);
+    p3d_env *env=(p3d_env*)p3d_get_desc_curid(P3D_ENV);
+    for(int i=0;env && i<env->no;++i){
+        p3d_obj *o=env->o[i];
+        key<<o->name<<":"<<o->BB.xmin<<","<<o->BB.xmax<<","<<o->BB.ymin<<","<<o->BB.ymax<<","<<o->BB.zmin<<","<<o->BB.zmax<<";";
+    }
+    return hashString(key.str());
+}
+
+uint64_t PlanningData::movableObstaclesHash() const
+{
+    std::ostringstream key;
+    key<<std::setprecision(9);
+    Scene *scene=global_Project->getActiveScene();
+    for(unsigned int i=0;i<scene->getNumberOfRobots();++i){
+        Robot *rob=scene->getRobot(i);
+        if(rob==r || rob==h) continue;
+        RobotState q=*rob->getCurrentPos();
+        key<<rob->getName()<<":";
+        for(uint d=6;d<12;++d) key<<q[d]<<",";
+        key<<";";
+    }
+    return hashString(key.str());
+}
+
+bool PlanningData::loadGridsCache(Precomputation &pre, const std::string &path)
+{
+    std::ifstream input(path,std::ios::in | std::ios::binary);
+    if(!input.is_open()) return false;
+    unsigned int version;
+    uint64_t key;
+    std::vector<double> envSize;
+    std::vector<float> cellSize;
+    std::vector<unsigned char> free_r,free_h;
+    float clearance;
+    try{
+        boost::archive::binary_iarchive ia(input);
+        ia >> version;
+        if(version!=gridsCacheVersion) return false;
+        ia >> key;
+        if(key!=gridsCacheKey()){
+            M3D_INFO("grids cache "<<path<<" is for another scene, ignored");
+            return false;
+        }
+        ia >> envSize >> cellSize >> free_r >> free_h >> clearance;
+    }catch(std::exception &e){
+        M3D_INFO("could not read the grids cache "<<path<<": "<<e.what());
+        return false;
+    }
+    API::nDimGrid<bool,2>::SpaceCoord cell_size;
+    cell_size[0]=cellSize.at(0);
+    cell_size[1]=cellSize.at(1);
+    pre.freespace_h=API::nDimGrid<bool,2>(cell_size,false,envSize);
+    pre.freespace_r=API::nDimGrid<bool,2>(cell_size,false,envSize);
+    if(free_r.size()!=pre.freespace_r.getNumberOfCells() || free_h.size()!=pre.freespace_h.getNumberOfCells()){
+        M3D_INFO("grids cache "<<path<<" does not match the scene, ignored");
+        return false;
+    }
+    for(uint i=0;i<pre.freespace_r.getNumberOfCells();++i){
+        pre.freespace_r[i]=free_r[i];
+        pre.freespace_h[i]=free_h[i];
+    }
+    API::nDimGrid<bool,2>::ArrayCoord last=pre.freespace_h.getCellCoord(pre.freespace_h.getNumberOfCells()-1);
+    pre.nx=last[0]+1;
+    pre.ny=last[1]+1;
+    pre.agentsClearance=clearance;
+    M3D_INFO("collision grids loaded from "<<path);
+    return true;
+}
+
+void PlanningData::saveGridsCache(Precomputation &pre, const std::string &path)
+{
+    std::vector<double> envSize(4,0.);
+    for(uint i=0;i<4;++i) envSize[i]=global_Project->getActiveScene()->getBounds()[i];
+    std::vector<float> cellSize{pre.freespace_h.getCellSize()[0],pre.freespace_h.getCellSize()[1]};
+    std::vector<unsigned char> free_r(pre.freespace_r.getNumberOfCells()),free_h(pre.freespace_h.getNumberOfCells());
+    for(uint i=0;i<free_r.size();++i){
+        free_r[i]=pre.freespace_r[i];
+        free_h[i]=pre.freespace_h[i];
+    }
+    //written aside then renamed, for a concurrent process never to read a partial file
+    std::string tmp_path=path+".tmp";
+    {
+    std::ofstream of(tmp_path,std::ios::out | std::ios::binary);
+    if(!of.is_open()){
+        M3D_INFO("cannot write the grids cache "<<tmp_path);
+        return;
+    }
+    boost::archive::binary_oarchive oa(of);
+    uint64_t key=gridsCacheKey();
+    oa << gridsCacheVersion << key << envSize << cellSize << free_r << free_h << pre.agentsClearance;
+    }
+    if(std::rename(tmp_path.c_str(),path.c_str())){
+        M3D_INFO("cannot write the grids cache "<<path);
+        std::remove(tmp_path.c_str());
+        return;
+    }
+    M3D_INFO("collision grids saved to "<<path);
+}
+
 } // namespace move4d
@@ -67,6 +67,31 @@ void PointingPlanner::initialize()
         parameter["desired_angle_h_tolerance"] = API::Parameter(15*M_PI/180);
         parameter["ask_to_move_dist_trigger"] = 0.4; // when to consider the robot will ask the human to move somewhere else
         parameter["ask_to_move_duration"] = 10.; // the time it takes to the robot to ask the human to move and indicate them where
+        parameter["threads"] = API::Parameter(0); // number of threads evaluating the costs during the search (0: one per core)
+        parameter["visibility_pruning"] = API::Parameter(false); // evaluate only the cells where the human sees all the mandatory targets
+        parameter["region_pruning"] = API::Parameter(false); // size the lattice to the rooms reachable from the starts that see the targets
+        parameter["doorway_width"] = API::Parameter(1.2); // passages narrower than this separate two rooms
+        parameter["refine"] = API::Parameter(false); // move the solution off the cell centers to a local minimum of the interpolated cost
+        parameter["group"] = API::Parameter(API::Parameter::ArrayValue); // other humans guided with "human" (group mode)
+        parameter["group_candidates"] = API::Parameter(20); // positions of each human of the group evaluated with each robot position
+        parameter["group_separation"] = API::Parameter(0.6); // minimal distance between two humans of the group
+        parameter["engine"] = API::Parameter("lattice"); // search: lattice, or sampling for large maps
+        parameter["sampling_samples"] = API::Parameter(2000); // placements drawn by the sampling engine (plus half as many to refine)
+        parameter["sampling_seed"] = API::Parameter(0); // seed of the sampling engine
+        parameter["move_set"] = API::Parameter("full"); // neighbours of a cell in the search: full, pruned (at most 2 axes), single_agent or axis
+        parameter["multires_levels"] = API::Parameter(0); // search first with cells 2^levels larger, then refine around the best ones
+        parameter["multires_candidates"] = API::Parameter(3); // number of cells refined at each level
+        parameter["any_target"] = API::Parameter(false); // the targets are alternatives, the one giving the best cell is shown
+        parameter["alternatives"] = API::Parameter(0); // number of ranked solutions written in result/alternatives (0: none)
+        parameter["alternatives_separation"] = API::Parameter(1.); // minimal distance of an agent between two alternatives with the same target
+        parameter["incremental"] = API::Parameter(false); // keep the cost terms and the solution of a run to repair it at the next one
+        parameter["deadline"] = API::Parameter(0.); // maximal duration of a run in seconds, the best solution so far is returned (0: none)
+        parameter["grids_cache"] = API::Parameter(true); // store the collision grids next to the visibility grid, to load them at the next start
+        parameter["scene_revision"] = API::Parameter(0); // change it when the movable obstacles moved, to recompute the collision grids
+        parameter["result_cache"] = API::Parameter(0); // number of results kept to answer the same queries without planning (0: no cache)
+        parameter["result_cache_resolution"] = API::Parameter(0.1); // start positions closer than this are the same query for the cache
+        // optional "footprint_radius_robot" and "footprint_radius_human": radius of the agent cylinders,
+        // when both are set the collision grids are computed from one collision grid and a distance transform
     }
     lock.unlock();
 
@@ -84,9 +109,69 @@ void PointingPlanner::initialize()
 void PointingPlanner::run()
 {
     M3D_DEBUG("PointingPlanner::run start");
+    std::lock_guard<std::mutex> lock(_asyncMutex);
+    preempt();
+    _data->cancelled=std::function<bool()>();
+    _data->progress=std::function<void(const PlanningData::Progress&)>();
     _data->run();
     M3D_DEBUG("PointingPlanner::run end");
 }
 
+PointingPlanner::RunHandle PointingPlanner::runAsync(std::function<void (const PlanningData::Progress &)> progress)
+{
+    std::lock_guard<std::mutex> lock(_asyncMutex);
+    preempt();
+    RunHandle handle;
+    handle._cancel=std::make_shared<std::atomic<bool> >(false);
+    std::shared_ptr<std::atomic<bool> > cancel=handle._cancel;
+    //_data stays for the cost space callbacks of this thread: the planning thread gets its own,
+    //with everything it reads from the scene and the parameters copied here. Its grids are computed by
+    //the planning thread (the first run() of a PlanningData does it), the caller only waits for the copies
+    std::shared_ptr<PlanningData> data=std::make_shared<PlanningData>(_data->r,_data->h,false);
+    data->getParameters();
+    data->snapshot=std::make_shared<const PlanningData::SceneSnapshot>(data->takeSnapshot());
+    data->cancelled=[cancel](){return cancel->load();};
+    data->progress=progress;
+    handle._data=data;
+    handle.result=std::async(std::launch::async,[data](){
+        M3D_DEBUG("PointingPlanner::runAsync start");
+        return data->run(false);
+    }).share();
+    _current=handle;
+    return handle;
+}
+
+void PointingPlanner::benchmarkMoveSets()
+{
+    std::lock_guard<std::mutex> lock(_asyncMutex);
+    preempt();
+    _data->cancelled=std::function<bool()>();
+    _data->progress=std::function<void(const PlanningData::Progress&)>();
+    _data->benchmarkMoveSets();
+}
+
+void PointingPlanner::preempt()
+{
+    if(_current.result.valid()){
+        _current.cancel();
+        _current.result.wait();
+        _current=RunHandle();
+    }
+}
+
+void PointingPlanner::RunHandle::cancel()
+{
+    if(_cancel) *_cancel=true;
+}
+
+PlanningData::Cell PointingPlanner::RunHandle::publish()
+{
+    PlanningData::Cell best=result.get();
+    //the run is over, the scene can be written
+    _data->snapshot.reset();
+    _data->publishResult(best);
+    return best;
+}
+
 
 } // namespace move4d
@@ -0,0 +1,101 @@
+#include "VisibilityGrid/RegionMap.hpp"
+#include "VisibilityGrid/DistanceTransform.hpp"
+
+#include <algorithm>
+#include <deque>
+
+namespace move4d {
+
+RegionMap::RegionMap():
+    _nx(0),
+    _ny(0)
+{
+}
+
+RegionMap::RegionMap(const FreeGrid &free, float doorway_width, WorkerPool &pool)
+{
+    FreeGrid::ArrayCoord last=free.getCellCoord(free.getNumberOfCells()-1);
+    _nx=last[0]+1;
+    _ny=last[1]+1;
+    const long nx=_nx, ny=_ny;
+    std::vector<unsigned char> occupied(nx*ny,1);
+    for(size_t i=0;i<free.getNumberOfCells();++i){
+        FreeGrid::ArrayCoord c=free.getCellCoord(i);
+        occupied[c[0]+nx*c[1]]=!free.getCell(i);
+    }
+    std::vector<float> dist2;
+    DistanceTransform(nx,ny,free.getCellSize()[0],free.getCellSize()[1]).computeSquared(occupied,dist2,pool);
+    const float min_dist2=doorway_width*doorway_width/4;
+
+    const long dx[4]={1,-1,0,0};
+    const long dy[4]={0,0,1,-1};
+    _labels.assign(nx*ny,-1);
+    int count=0;
+    std::deque<long> open;
+    //the cores, 4-connected
+    for(long s=0;s<nx*ny;++s){
+        if(occupied[s] || dist2[s]<min_dist2 || _labels[s]>=0) continue;
+        _labels[s]=count;
+        open.push_back(s);
+        while(!open.empty()){
+            long i=open.front();
+            open.pop_front();
+            long x=i%nx, y=i/nx;
+            for(int k=0;k<4;++k){
+                long xn=x+dx[k], yn=y+dy[k];
+                if(xn<0 || xn>=nx || yn<0 || yn>=ny) continue;
+                long n=xn+nx*yn;
+                if(occupied[n] || dist2[n]<min_dist2 || _labels[n]>=0) continue;
+                _labels[n]=count;
+                open.push_back(n);
+            }
+        }
+        ++count;
+    }
+
+    //the rest of the free space grows from the cores, breadth first.
+    //Free cells out of reach of any core (narrow dead ends) get regions of their own
+    auto grow=[&](){
+        while(!open.empty()){
+            long i=open.front();
+            open.pop_front();
+            long x=i%nx, y=i/nx;
+            for(int k=0;k<4;++k){
+                long xn=x+dx[k], yn=y+dy[k];
+                if(xn<0 || xn>=nx || yn<0 || yn>=ny) continue;
+                long n=xn+nx*yn;
+                if(occupied[n] || _labels[n]>=0) continue;
+                _labels[n]=_labels[i];
+                open.push_back(n);
+            }
+        }
+    };
+    for(long i=0;i<nx*ny;++i){
+        if(_labels[i]>=0) open.push_back(i);
+    }
+    grow();
+    for(long s=0;s<nx*ny;++s){
+        if(occupied[s] || _labels[s]>=0) continue;
+        _labels[s]=count++;
+        open.push_back(s);
+        grow();
+    }
+
+    _adjacent.assign(count,std::vector<int>());
+    for(long y=0;y<ny;++y){
+        for(long x=0;x<nx;++x){
+            int a=_labels[x+nx*y];
+            if(a<0) continue;
+            int neighbours[2]={(x+1<nx ? _labels[x+1+nx*y] : -1), (y+1<ny ? _labels[x+nx*(y+1)] : -1)};
+            for(int b : neighbours){
+                if(b<0 || b==a) continue;
+                if(std::find(_adjacent[a].begin(),_adjacent[a].end(),b)==_adjacent[a].end()){
+                    _adjacent[a].push_back(b);
+                    _adjacent[b].push_back(a);
+                }
+            }
+        }
+    }
+}
+
+} // namespace move4d
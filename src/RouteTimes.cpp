@@ -0,0 +1,48 @@
+#include "VisibilityGrid/RouteTimes.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <queue>
+#include <utility>
+
+namespace move4d {
+
+RouteTimes::RouteTimes():
+    _n(0)
+{
+}
+
+RouteTimes::RouteTimes(unsigned int nodes, const std::vector<Edge> &edges):
+    _n(nodes),
+    _times(size_t(nodes)*nodes,std::numeric_limits<float>::infinity())
+{
+    //adjacency lists, the route graphs are sparse: one dijkstra per node
+    std::vector<std::vector<std::pair<unsigned int,float> > > adjacent(_n);
+    for(const Edge &e : edges){
+        if(e.from>=_n || e.to>=_n || !(e.time>=0.f)) continue;
+        adjacent[e.from].push_back(std::make_pair(e.to,e.time));
+        adjacent[e.to].push_back(std::make_pair(e.from,e.time));
+    }
+
+    typedef std::pair<float,unsigned int> Entry;
+    for(unsigned int s=0;s<_n;++s){
+        float *dist=&_times[size_t(s)*_n];
+        std::priority_queue<Entry,std::vector<Entry>,std::greater<Entry> > open;
+        dist[s]=0.f;
+        open.push(Entry(0.f,s));
+        while(!open.empty()){
+            Entry top=open.top();
+            open.pop();
+            if(top.first>dist[top.second]) continue; //outdated
+            for(const std::pair<unsigned int,float> &n : adjacent[top.second]){
+                float d=top.first+n.second;
+                if(d<dist[n.first]){
+                    dist[n.first]=d;
+                    open.push(Entry(d,n.first));
+                }
+            }
+        }
+    }
+}
+
+} // namespace move4d
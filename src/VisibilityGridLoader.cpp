@@ -59,6 +59,7 @@ bool VisibilityGridLoader::loadBinary(){
     boost::archive::binary_iarchive ia(input);
     ia >> *_grid;
     input.close();
+    ++_revision;
     return true;
 }
 
@@ -72,6 +73,7 @@ bool VisibilityGridLoader::loadText()
     boost::archive::text_iarchive ia(input);
     ia >> *_grid;
     input.close();
+    ++_revision;
     return true;
 }
 
@@ -80,4 +82,17 @@ VisibilityGrid3d *VisibilityGridLoader::grid() const
     return _grid;
 }
 
+bool VisibilityGridLoader::reload()
+{
+    if(!_grid){
+        initialize();
+        return _revision>0;
+    }
+    if(!(loadBinary() || loadText())){
+        M3D_ERROR("could not read file visibility_grid_bin.txt nor visibility_grid_bin");
+        return false;
+    }
+    return true;
+}
+
 } // namespace move4d
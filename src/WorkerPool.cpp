@@ -0,0 +1,85 @@
+#include "VisibilityGrid/WorkerPool.hpp"
+
+#include <algorithm>
+
+namespace move4d {
+
+WorkerPool::WorkerPool(unsigned int threads):
+    _size(threads ? threads : std::max(1u,std::thread::hardware_concurrency())),
+    _next(0)
+{
+    for(unsigned int i=1;i<_size;++i){
+        _threads.push_back(std::thread(&WorkerPool::loop,this,i));
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop=true;
+    }
+    _wake.notify_all();
+    for(std::thread &t : _threads){
+        t.join();
+    }
+}
+
+void WorkerPool::parallelFor(size_t n, const std::function<void(size_t, unsigned int)> &job)
+{
+    if(_threads.empty() || n<=1){
+        for(size_t i=0;i<n;++i){
+            job(i,0);
+        }
+        return;
+    }
+    {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _job=&job;
+    _n=n;
+    _next=0;
+    _running=_threads.size();
+    _error=nullptr;
+    ++_generation;
+    }
+    _wake.notify_all();
+    work(0);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done.wait(lock,[this]{return _running==0;});
+    _job=nullptr;
+    if(_error){
+        std::exception_ptr e=_error;
+        _error=nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+void WorkerPool::work(unsigned int worker)
+{
+    for(size_t i=_next++; i<_n; i=_next++){
+        try{
+            (*_job)(i,worker);
+        }catch(...){
+            std::lock_guard<std::mutex> lock(_mutex);
+            if(!_error) _error=std::current_exception();
+        }
+    }
+}
+
+void WorkerPool::loop(unsigned int worker)
+{
+    unsigned long seen=0;
+    std::unique_lock<std::mutex> lock(_mutex);
+    while(true){
+        _wake.wait(lock,[&]{return _stop || _generation!=seen;});
+        if(_stop) return;
+        seen=_generation;
+        lock.unlock();
+        work(worker);
+        lock.lock();
+        if(--_running==0) _done.notify_one();
+    }
+}
+
+} // namespace move4d